@@ -0,0 +1,323 @@
+#include "analyse.h"
+#include "mappedfile.h" // MappedFile
+#include "move.h" // moveToString()
+#include "position.h" // Position, FenError, fenErrorToString()
+#include "pawns.h" // PawnTablePool
+#include "search.h" // Search::go(), SearchLimits, SearchResult, scoreToString(), MAX_PLY, MAX_THREADS
+#include "tt.h" // TranspositionTable, DEFAULT_HASH_MB, MAX_HASH_MB
+#include "types.h" // U64
+
+#include <algorithm> // std::min(), std::max(), std::clamp()
+#include <atomic> // std::atomic
+#include <chrono> // std::chrono::steady_clock, std::chrono::duration_cast
+#include <condition_variable> // std::condition_variable
+#include <cstddef> // std::size_t
+#include <exception> // std::exception
+#include <filesystem> // std::filesystem::file_size()
+#include <fstream> // std::ofstream
+#include <functional> // std::ref()
+#include <iostream> // std::cout, std::cerr
+#include <mutex> // std::mutex, std::unique_lock, std::lock_guard
+#include <string> // std::string, std::stoi(), std::stoull()
+#include <string_view> // std::string_view
+#include <system_error> // std::error_code
+#include <thread> // std::thread
+#include <vector> // std::vector
+
+/*
+ * Settings of a batch run, taken from the command line.
+ */
+struct AnalyseOptions
+{
+    std::string inputFile {};
+    std::string outputFile {};
+    SearchLimits limits {};
+    int numThreads { 1 };
+    int hashMegabytes { DEFAULT_HASH_MB };
+};
+
+/*
+ * Lines of the input are handed out to the workers in chunks.
+ * A worker fills in its chunk's output and marks it done,
+ * and the writer emits the chunks strictly in input order.
+ */
+struct AnalyseChunk
+{
+    std::string output {};
+    bool done { false };
+};
+
+/*
+ * State shared by the workers and the writer of one batch run.
+ */
+struct AnalyseState
+{
+    const AnalyseOptions& options;
+    const std::vector<std::string_view>& lines;
+    std::size_t chunkLines;
+    std::vector<AnalyseChunk> chunks;
+    std::atomic<std::size_t> nextChunk { 0 };
+    std::atomic<U64> totalNodes { 0 };
+    std::mutex chunkMutex {};
+    std::condition_variable chunkDone {};
+};
+
+/*
+ * Split the input into its non-empty lines, without copying them.
+ */
+std::vector<std::string_view> splitLines(std::string_view text)
+{
+    std::vector<std::string_view> lines {};
+    while(!text.empty())
+    {
+        std::size_t lineEnd { std::min(text.find('\n'), text.size()) };
+        std::string_view line { text.substr(0, lineEnd) };
+        while(!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+            line.remove_suffix(1);
+        if(!line.empty())
+            lines.push_back(line);
+        text.remove_prefix(std::min(lineEnd + 1, text.size()));
+    }
+    return lines;
+}
+
+/*
+ * Return the next whitespace separated field of text, and remove it from text.
+ */
+std::string_view nextField(std::string_view& text)
+{
+    std::size_t start { std::min(text.find_first_not_of(" \t"), text.size()) };
+    text.remove_prefix(start);
+    std::size_t end { std::min(text.find_first_of(" \t"), text.size()) };
+    std::string_view field { text.substr(0, end) };
+    text.remove_prefix(end);
+    return field;
+}
+
+bool isNumber(std::string_view field)
+{
+    return !field.empty() && field.find_first_not_of("0123456789") == std::string_view::npos;
+}
+
+/*
+ * Split an EPD or FEN line into the position and the EPD operations.
+ * Both start with the four position fields. A FEN follows them with the two
+ * move counters, an EPD with operations such as bm e4; id "WAC.001";
+ */
+std::string_view splitPosition(std::string_view line, std::string_view& operations)
+{
+    std::string_view rest { line };
+    for(int field { 0 }; field < 4; ++field)
+        nextField(rest);
+
+    std::string_view counters { rest };
+    if(isNumber(nextField(counters)) && isNumber(nextField(counters)))
+        rest = counters;
+
+    operations = rest.substr(std::min(rest.find_first_not_of(" \t"), rest.size()));
+    return line.substr(0, line.size() - rest.size());
+}
+
+/*
+ * Return the value of the EPD id operation, quotes included, or an empty view.
+ */
+std::string_view findEpdId(std::string_view operations)
+{
+    for(std::size_t position { operations.find("id ") }; position != std::string_view::npos; position = operations.find("id ", position + 1))
+    {
+        if(position == 0 || operations[position - 1] == ' ' || operations[position - 1] == ';')
+        {
+            std::string_view id { operations.substr(position + 3) };
+            return id.substr(0, std::min(id.find(';'), id.size()));
+        }
+    }
+    return {};
+}
+
+/*
+ * Analyse the lines of the chunks handed out to this worker, one search at a time.
+ * Every worker owns its position, search stop flag, transposition table and pawn
+ * table, so the workers never contend. The tables are cleared before every position,
+ * so a result does not depend on the lines the worker searched before, and the
+ * output is the same for any number of threads.
+ */
+void analyseWorker(AnalyseState& state)
+{
+    const AnalyseOptions& options { state.options };
+    TranspositionTable transpositionTable {};
+    PawnTablePool pawnTables {};
+    if(!transpositionTable.resize(static_cast<std::size_t>(options.hashMegabytes), 1))
+        std::cerr << "Cannot allocate " + std::to_string(options.hashMegabytes) + " MB of hash per thread, using "
+                     + std::to_string(transpositionTable.getMegabytes()) + " MB\n";
+    Position position {};
+    std::atomic<bool> stopFlag { false };
+    const std::atomic<bool> ponderFlag { false };
+
+    for(std::size_t chunk { state.nextChunk++ }; chunk < state.chunks.size(); chunk = state.nextChunk++)
+    {
+        std::string output {};
+        const std::size_t firstLine { chunk * state.chunkLines };
+        const std::size_t lastLine { std::min(firstLine + state.chunkLines, state.lines.size()) };
+        for(std::size_t lineIndex { firstLine }; lineIndex < lastLine; ++lineIndex)
+        {
+            std::string_view operations {};
+            const std::string_view fen { splitPosition(state.lines[lineIndex], operations) };
+            output.append(fen);
+
+            if(const FenError error { position.setFromFen(fen) }; error != FenError::NONE)
+            {
+                output.append(" error ").append(fenErrorToString(error)).append("\n");
+                continue;
+            }
+
+            transpositionTable.clear(1);
+            pawnTables.clear();
+            stopFlag.store(false, std::memory_order_relaxed);
+            const SearchResult result { Search::go(position, options.limits, transpositionTable, pawnTables, 1, stopFlag, ponderFlag, false) };
+            state.totalNodes.fetch_add(result.nodes, std::memory_order_relaxed);
+
+            output.append(" bestmove ").append(moveToString(result.bestMove))
+                  .append(" score ").append(scoreToString(result.score))
+                  .append(" depth ").append(std::to_string(result.depth))
+                  .append(" nodes ").append(std::to_string(result.nodes));
+            if(const std::string_view id { findEpdId(operations) }; !id.empty())
+                output.append(" id ").append(id);
+            output += '\n';
+        }
+
+        {
+            std::lock_guard<std::mutex> lock { state.chunkMutex };
+            state.chunks[chunk].output = std::move(output);
+            state.chunks[chunk].done = true;
+        }
+        state.chunkDone.notify_one();
+    }
+}
+
+/*
+ * Parse the command line arguments following "analyse".
+ * Return false, after printing the reason, if they are invalid.
+ */
+bool parseOptions(const std::vector<std::string>& arguments, AnalyseOptions& options)
+{
+    options.numThreads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    options.limits.depth = DEFAULT_ANALYSE_DEPTH;
+    bool depthGiven { false };
+
+    try
+    {
+        for(std::size_t index { 0 }; index < arguments.size(); ++index)
+        {
+            const std::string& argument { arguments[index] };
+            const bool hasValue { index + 1 < arguments.size() };
+
+            if(argument == "--depth" && hasValue)
+            {
+                options.limits.depth = std::clamp(std::stoi(arguments[++index]), 1, MAX_PLY - 1);
+                depthGiven = true;
+            }
+            else if(argument == "--nodes" && hasValue) options.limits.nodes = std::stoull(arguments[++index]);
+            else if(argument == "--movetime" && hasValue) options.limits.moveTime = std::max(std::stoi(arguments[++index]), 1);
+            else if(argument == "--threads" && hasValue) options.numThreads = std::clamp(std::stoi(arguments[++index]), 1, MAX_THREADS);
+            else if(argument == "--hash" && hasValue) options.hashMegabytes = std::clamp(std::stoi(arguments[++index]), 1, MAX_HASH_MB);
+            else if(argument == "--output" && hasValue) options.outputFile = arguments[++index];
+            else if(argument.rfind("--", 0) != 0 && options.inputFile.empty()) options.inputFile = argument;
+            else
+            {
+                std::cerr << "Unknown or incomplete argument " << argument << '\n';
+                return false;
+            }
+        }
+    }
+    catch(const std::exception&)
+    {
+        std::cerr << "Invalid argument value\n";
+        return false;
+    }
+
+    // Node and time limited runs search as deep as the limit allows, unless a depth is also given
+    if(!depthGiven && (options.limits.nodes || options.limits.moveTime))
+        options.limits.depth = MAX_PLY - 1;
+
+    if(options.inputFile.empty())
+    {
+        std::cerr << "Usage: Venenum analyse <file> [--depth <x>] [--nodes <x>] [--movetime <x>] "
+                     "[--threads <x>] [--hash <x>] [--output <file>]\n";
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Venenum analyse <file> [--depth <x>] [--nodes <x>] [--movetime <x>] [--threads <x>] [--hash <x>] [--output <file>]
+ * Search every FEN or EPD line of file with the given limits, depth 10 by default, and write
+ * "<fen> bestmove <move> score <cp <x> | mate <y>> depth <x> nodes <x> [id <id>]"
+ * per line, in input order, to the output file or standard output.
+ * The file is memory mapped and its lines are spread over a pool of threads,
+ * each running its own single threaded search with a private hash table of --hash MB.
+ * A summary with the positions per second is printed to standard error.
+ */
+int Analyse::runBatch(const std::vector<std::string>& arguments)
+{
+    AnalyseOptions options {};
+    if(!parseOptions(arguments, options))
+        return 1;
+
+    // An empty file cannot be mapped, but is valid input without positions
+    MappedFile inputFile {};
+    std::error_code fileError {};
+    if(!inputFile.open(options.inputFile) && (std::filesystem::file_size(options.inputFile, fileError) != 0 || fileError))
+    {
+        std::cerr << "Cannot open " << options.inputFile << '\n';
+        return 1;
+    }
+
+    std::ofstream outputFile {};
+    if(!options.outputFile.empty())
+    {
+        outputFile.open(options.outputFile, std::ios::binary);
+        if(!outputFile)
+        {
+            std::cerr << "Cannot open " << options.outputFile << '\n';
+            return 1;
+        }
+    }
+    std::ostream& output { options.outputFile.empty() ? std::cout : outputFile };
+
+    const std::chrono::steady_clock::time_point startTime { std::chrono::steady_clock::now() };
+    const std::vector<std::string_view> lines { splitLines(inputFile.view()) };
+
+    // Several chunks per thread keep the threads busy until the end, even when search times vary
+    const std::size_t numThreads { static_cast<std::size_t>(options.numThreads) };
+    const std::size_t chunkLines { std::clamp<std::size_t>(lines.size() / (numThreads * 8), 1, 64) };
+    AnalyseState state { options, lines, chunkLines, std::vector<AnalyseChunk>((lines.size() + chunkLines - 1) / chunkLines) };
+
+    std::vector<std::thread> workers {};
+    for(std::size_t id { 0 }; id < std::min(numThreads, state.chunks.size()); ++id)
+        workers.emplace_back(analyseWorker, std::ref(state));
+
+    for(AnalyseChunk& chunk : state.chunks)
+    {
+        std::string chunkOutput {};
+        {
+            std::unique_lock<std::mutex> lock { state.chunkMutex };
+            state.chunkDone.wait(lock, [&chunk]() { return chunk.done; });
+            chunkOutput = std::move(chunk.output);
+        }
+        output << chunkOutput << std::flush;
+    }
+
+    for(std::thread& worker : workers)
+        worker.join();
+
+    const long long milliseconds { std::max(static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count()), 1LL) };
+    const U64 totalNodes { state.totalNodes.load() };
+    std::cerr << "Positions: " << lines.size()
+              << "\nThreads: " << workers.size()
+              << "\nTime (ms): " << milliseconds
+              << "\nPositions per second: " << static_cast<double>(lines.size()) * 1000.0 / static_cast<double>(milliseconds)
+              << "\nNodes: " << totalNodes
+              << "\nNodes per second: " << totalNodes * 1000 / static_cast<U64>(milliseconds) << '\n';
+
+    return output ? 0 : 1;
+}
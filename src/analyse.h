@@ -0,0 +1,14 @@
+#ifndef ANALYSE_H
+#define ANALYSE_H
+
+#include <string> // std::string
+#include <vector> // std::vector
+
+inline constexpr int DEFAULT_ANALYSE_DEPTH { 10 };
+
+namespace Analyse
+{
+    int runBatch(const std::vector<std::string>& arguments);
+}
+
+#endif
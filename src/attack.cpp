@@ -1,172 +1,237 @@
 #include "attack.h"
 #include "bitboard.h" // squareToBitboard()
-#include "types.h" // U64, File, Rank, LERFSquare, RayDirection, FancyMagic
+#include "types.h" // U64, File, Rank, LERFSquare, RayDirection, FancyMagic, PextEntry
+
+#include <array> // std::array
+#include <bit> // std::popcount()
+#include <cstddef> // std::size_t
 
 /*
  * Return valid if a slide move of a bishop or rook
  * stayed on the board, and did not wrap around the board
  * to an opposite side file or rank.
  */
-bool slideIsValid(int from, int to)
+constexpr bool slideIsValid(int from, int to)
 {
-    File fromFile { from % NUM_FILES };
-    File toFile { to % NUM_FILES };
-    int fileDistance { fromFile - toFile };
-    
-    Rank fromRank { from / NUM_RANKS };
-    Rank toRank { to / NUM_RANKS };
-    int rankDistance { fromRank - toRank };
+    int fileDistance { from % NUM_FILES - to % NUM_FILES };
+    int rankDistance { from / NUM_RANKS - to / NUM_RANKS };
 
     return to >= A1 && to < NUM_SQUARES && fileDistance > -2 && fileDistance < 2 && rankDistance > -2 && rankDistance < 2;
 }
 
 /*
- * Return a bitboard containing all attacked
- * squares on the board from a rook on sq with
- * a relevant occupancy. This includes attacked
- * squares with blocker pieces on them.
+ * Return a bitboard containing all attacked squares on the board
+ * from a slider on sq moving along the given directions with
+ * a relevant occupancy. This includes attacked squares with blocker
+ * pieces on them.
  */
-U64 calculateRookAttacks(int sq, U64 occupancy)
+constexpr U64 calculateSliderAttacks(int sq, U64 occupancy, const RayDirection (&directions)[4])
 {
     U64 attack { 0ULL };
-    RayDirection rookDirections[4] { NORTH, EAST, SOUTH, WEST };
-    for(RayDirection dir: rookDirections)
+    for(RayDirection dir: directions)
     {
         int curSq { sq + dir };
         int prevSq { sq };
-        U64 bbSq { squareToBitboard(sq) };
         while(slideIsValid(prevSq, curSq))
         {
+            U64 bbSq { squareToBitboard(curSq) };
             attack |= bbSq;
 
             if(occupancy & bbSq) break;
 
             prevSq = curSq;
             curSq += dir;
-            bbSq = squareToBitboard(curSq);
         }
     }
 
     return attack;
 }
 
+constexpr RayDirection ROOK_DIRECTIONS[4] { NORTH, EAST, SOUTH, WEST };
+constexpr RayDirection BISHOP_DIRECTIONS[4] { NORTH_EAST, SOUTH_EAST, SOUTH_WEST, NORTH_WEST };
+
+constexpr U64 calculateRookAttacks(int sq, U64 occupancy)
+{
+    return calculateSliderAttacks(sq, occupancy, ROOK_DIRECTIONS);
+}
+
+constexpr U64 calculateBishopAttacks(int sq, U64 occupancy)
+{
+    return calculateSliderAttacks(sq, occupancy, BISHOP_DIRECTIONS);
+}
+
+/*
+ * Offset of every square's block in a magic attack table. Each square owns
+ * 2^(64 - shift) entries, placed one after another starting from A1.
+ */
+constexpr std::array<std::size_t, NUM_SQUARES> magicTableOffsets(const int shifts[])
+{
+    std::array<std::size_t, NUM_SQUARES> offsets {};
+    for(std::size_t sq { A1 + 1 }; sq < NUM_SQUARES; ++sq)
+        offsets[sq] = offsets[sq - 1] + (1ULL << (64 - shifts[sq - 1]));
+    return offsets;
+}
+
 /*
- * Loop through all the squares, and initialize attack bitboards
- * for rook pieces with all possible relevant occupancies for that
+ * Loop through all the squares, and generate attack bitboards
+ * for a slider with all possible relevant occupancies for that
  * square. The traversal of all subsets of a specific occupancy uses
  * the formula a = (a - b) & b. Called the Carry-Rippler method, introduced
  * by Marcel van Kervinck and later by Steffan Westcott.
  */
-void initRookAttacks()
+template<std::size_t TableSize>
+constexpr std::array<U64, TableSize> makeMagicAttackTable(const U64 magicNumbers[], const int shifts[], const U64 occupancyMasks[], U64 (*calculateAttacks)(int, U64))
 {
+    std::array<U64, TableSize> attackTable {};
+    const std::array<std::size_t, NUM_SQUARES> offsets { magicTableOffsets(shifts) };
     for(int sq { A1 }; sq < NUM_SQUARES; ++sq)
     {
-        FancyMagic& curMagic = ROOK_FANCY_MAGICS[sq];
-        curMagic.shift = ROOK_SHIFT[sq];
-        curMagic.magicNumber = ROOK_MAGIC_NUMBERS[sq];
-        curMagic.occupancyMask = ROOK_OCCUPANCY[sq];
-
-        // Calculate pointer address into ROOK_ATTACKS_TABLE for sq
-        if(sq == A1)
-        {
-            curMagic.attackTablePointer = ROOK_ATTACKS_TABLE;
-        }
-        else
-        {
-            U64* previousSqPointer = ROOK_FANCY_MAGICS[sq - 1].attackTablePointer;
-            int fancyBitsUsed = 64 - ROOK_SHIFT[sq - 1];
-            int pointerOffset = 1ULL << fancyBitsUsed;
-            curMagic.attackTablePointer = previousSqPointer + pointerOffset;
-        }
-        
-
         U64 currentOccupancy { 0ULL };
         do
         {
-            U64 curIndex { (currentOccupancy * curMagic.magicNumber) >> curMagic.shift };
-            U64 curAttack { calculateRookAttacks(sq, currentOccupancy) };
-
-            curMagic.attackTablePointer[curIndex] = curAttack;
+            U64 curIndex { (currentOccupancy * magicNumbers[sq]) >> shifts[sq] };
+            attackTable[offsets[static_cast<std::size_t>(sq)] + curIndex] = calculateAttacks(sq, currentOccupancy);
 
-            currentOccupancy = (currentOccupancy - curMagic.occupancyMask) & curMagic.occupancyMask;
+            currentOccupancy = (currentOccupancy - occupancyMasks[sq]) & occupancyMasks[sq];
         } while (currentOccupancy);
     }
+    return attackTable;
 }
 
 /*
- * Return a bitboard containing all attacked
- * squares on the board from a bishop on sq with
- * a relevant occupancy. This includes attacked
- * squares with blocker pieces on them.
+ * Point every square's FancyMagic at its block in the attack table.
  */
-U64 calculateBishopAttacks(int sq, U64 occupancy)
+constexpr std::array<FancyMagic, NUM_SQUARES> makeFancyMagics(const U64* attackTable, const U64 magicNumbers[], const int shifts[], const U64 occupancyMasks[])
 {
-    U64 attack { 0ULL };
-    RayDirection bishopDirections[4] { NORTH_EAST, SOUTH_EAST, SOUTH_WEST, NORTH_WEST };
-    for(RayDirection dir: bishopDirections)
+    std::array<FancyMagic, NUM_SQUARES> magics {};
+    const std::array<std::size_t, NUM_SQUARES> offsets { magicTableOffsets(shifts) };
+    for(std::size_t sq { A1 }; sq < NUM_SQUARES; ++sq)
+        magics[sq] = FancyMagic { attackTable + offsets[sq], occupancyMasks[sq], magicNumbers[sq], shifts[sq] };
+    return magics;
+}
+
+constexpr std::array<U64, 0x16200> ROOK_ATTACKS_TABLE {
+    makeMagicAttackTable<0x16200>(ROOK_MAGIC_NUMBERS, ROOK_SHIFT, ROOK_OCCUPANCY, calculateRookAttacks)
+};
+constexpr std::array<U64, 0x12C0> BISHOP_ATTACKS_TABLE {
+    makeMagicAttackTable<0x12C0>(BISHOP_MAGIC_NUMBERS, BISHOP_SHIFT, BISHOP_OCCUPANCY, calculateBishopAttacks)
+};
+
+constexpr std::array<FancyMagic, NUM_SQUARES> ROOK_FANCY_MAGICS {
+    makeFancyMagics(ROOK_ATTACKS_TABLE.data(), ROOK_MAGIC_NUMBERS, ROOK_SHIFT, ROOK_OCCUPANCY)
+};
+constexpr std::array<FancyMagic, NUM_SQUARES> BISHOP_FANCY_MAGICS {
+    makeFancyMagics(BISHOP_ATTACKS_TABLE.data(), BISHOP_MAGIC_NUMBERS, BISHOP_SHIFT, BISHOP_OCCUPANCY)
+};
+
+#if defined(USE_PEXT)
+/*
+ * Loop through all the squares, and generate the dense PEXT attack table
+ * of a slider type. Each square takes 2^(relevant occupancy bits) entries.
+ * The PEXT of a subset of the occupancy mask equals its position in
+ * Carry-Rippler order, so the table is filled front to back without
+ * needing the (non constexpr) PEXT instruction itself.
+ */
+template<std::size_t TableSize>
+constexpr std::array<U64, TableSize> makePextAttackTable(const U64 occupancyMasks[], U64 (*calculateAttacks)(int, U64))
+{
+    std::array<U64, TableSize> attackTable {};
+    std::size_t index { 0 };
+    for(int sq { A1 }; sq < NUM_SQUARES; ++sq)
     {
-        int curSq { sq + dir };
-        int prevSq { sq };
-        U64 bbSq { squareToBitboard(curSq) };
-        while(slideIsValid(prevSq, curSq))
+        U64 currentOccupancy { 0ULL };
+        do
         {
-            attack |= bbSq;
-
-            if(occupancy & bbSq) break;
-
-            prevSq = curSq;
-            curSq += dir;
-            bbSq = squareToBitboard(curSq);
-        }
+            attackTable[index++] = calculateAttacks(sq, currentOccupancy);
+            currentOccupancy = (currentOccupancy - occupancyMasks[sq]) & occupancyMasks[sq];
+        } while (currentOccupancy);
     }
-
-    return attack;
+    return attackTable;
 }
 
 /*
- * Loop through all the squares, and initialize attack bitboards
- * for bishop pieces with all possible relevant occupancies for that
- * square. The traversal of all subsets of a specific occupancy uses
- * the formula a = (a - b) & b. Called the Carry-Rippler method, introduced
- * by Marcel van Kervinck and later by Steffan Westcott.
+ * Point every square's PextEntry at its block in the attack table.
  */
-void initBishopAttacks()
+constexpr std::array<PextEntry, NUM_SQUARES> makePextEntries(const U64* attackTable, const U64 occupancyMasks[])
 {
-    for(int sq { A1 }; sq < NUM_SQUARES; ++sq)
+    std::array<PextEntry, NUM_SQUARES> entries {};
+    for(std::size_t sq { A1 }; sq < NUM_SQUARES; ++sq)
     {
-        FancyMagic& curMagic = BISHOP_FANCY_MAGICS[sq];
-        curMagic.shift = BISHOP_SHIFT[sq];
-        curMagic.magicNumber = BISHOP_MAGIC_NUMBERS[sq];
-        curMagic.occupancyMask = BISHOP_OCCUPANCY[sq];
-
-        // Calculate pointer address into BISHOP_ATTACKS_TABLE for sq
-        if(sq == A1)
-        {
-            curMagic.attackTablePointer = BISHOP_ATTACKS_TABLE;
-        }
-        else
-        {
-            U64* previousSqPointer = BISHOP_FANCY_MAGICS[sq - 1].attackTablePointer;
-            int fancyBitsUsed = 64 - BISHOP_SHIFT[sq - 1];
-            int pointerOffset = 1ULL << fancyBitsUsed;
-            curMagic.attackTablePointer = previousSqPointer + pointerOffset;
-        }
+        entries[sq] = PextEntry { attackTable, occupancyMasks[sq] };
+        attackTable += 1ULL << std::popcount(occupancyMasks[sq]);
+    }
+    return entries;
+}
 
+/*
+ * Check that the PEXT backend returns the same attacks as the magic
+ * backend for every square and every relevant occupancy subset.
+ */
+constexpr bool pextMatchesMagic(const std::array<PextEntry, NUM_SQUARES>& pextEntries, const std::array<FancyMagic, NUM_SQUARES>& magics)
+{
+    for(std::size_t sq { A1 }; sq < NUM_SQUARES; ++sq)
+    {
+        const PextEntry& entry = pextEntries[sq];
+        const FancyMagic& magic = magics[sq];
         U64 currentOccupancy { 0ULL };
+        std::size_t pextIndex { 0 };
         do
         {
-            U64 curIndex { (currentOccupancy * curMagic.magicNumber) >> curMagic.shift };
-            U64 curAttack { calculateBishopAttacks(sq, currentOccupancy) };
-
-            curMagic.attackTablePointer[curIndex] = curAttack;
-
-            currentOccupancy = (currentOccupancy - curMagic.occupancyMask) & curMagic.occupancyMask;
+            U64 pextAttack { entry.attackTablePointer[pextIndex++] };
+            U64 magicAttack { magic.attackTablePointer[(currentOccupancy * magic.magicNumber) >> magic.shift] };
+            if(pextAttack != magicAttack)
+                return false;
+            currentOccupancy = (currentOccupancy - entry.occupancyMask) & entry.occupancyMask;
         } while (currentOccupancy);
     }
+    return true;
 }
 
-void Attack::initBishopRookAttacks()
+constexpr std::array<U64, 0x19000> ROOK_PEXT_ATTACKS_TABLE {
+    makePextAttackTable<0x19000>(ROOK_OCCUPANCY, calculateRookAttacks)
+};
+constexpr std::array<U64, 0x1480> BISHOP_PEXT_ATTACKS_TABLE {
+    makePextAttackTable<0x1480>(BISHOP_OCCUPANCY, calculateBishopAttacks)
+};
+
+constexpr std::array<PextEntry, NUM_SQUARES> ROOK_PEXT { makePextEntries(ROOK_PEXT_ATTACKS_TABLE.data(), ROOK_OCCUPANCY) };
+constexpr std::array<PextEntry, NUM_SQUARES> BISHOP_PEXT { makePextEntries(BISHOP_PEXT_ATTACKS_TABLE.data(), BISHOP_OCCUPANCY) };
+
+static_assert(pextMatchesMagic(ROOK_PEXT, ROOK_FANCY_MAGICS), "PEXT and magic rook attacks differ");
+static_assert(pextMatchesMagic(BISHOP_PEXT, BISHOP_FANCY_MAGICS), "PEXT and magic bishop attacks differ");
+#endif
+
+/*
+ * Loop through all pairs of squares sharing a rank, file or diagonal,
+ * and generate the line and between bitboards from the slider rays.
+ * If between is set the squares between are returned, else the full line.
+ */
+constexpr std::array<std::array<U64, NUM_SQUARES>, NUM_SQUARES> makeLineBetween(bool between)
 {
-    initRookAttacks();
-    initBishopAttacks();
-}
\ No newline at end of file
+    std::array<std::array<U64, NUM_SQUARES>, NUM_SQUARES> table {};
+    for(int sq1 { A1 }; sq1 < NUM_SQUARES; ++sq1)
+    {
+        for(int sq2 { A1 }; sq2 < NUM_SQUARES; ++sq2)
+        {
+            U64 bbSq1 { squareToBitboard(sq1) };
+            U64 bbSq2 { squareToBitboard(sq2) };
+
+            if(calculateRookAttacks(sq1, 0ULL) & bbSq2)
+            {
+                table[static_cast<std::size_t>(sq1)][static_cast<std::size_t>(sq2)] = between
+                    ? calculateRookAttacks(sq1, bbSq2) & calculateRookAttacks(sq2, bbSq1)
+                    : (calculateRookAttacks(sq1, 0ULL) & calculateRookAttacks(sq2, 0ULL)) | bbSq1 | bbSq2;
+            }
+            else if(calculateBishopAttacks(sq1, 0ULL) & bbSq2)
+            {
+                table[static_cast<std::size_t>(sq1)][static_cast<std::size_t>(sq2)] = between
+                    ? calculateBishopAttacks(sq1, bbSq2) & calculateBishopAttacks(sq2, bbSq1)
+                    : (calculateBishopAttacks(sq1, 0ULL) & calculateBishopAttacks(sq2, 0ULL)) | bbSq1 | bbSq2;
+            }
+        }
+    }
+    return table;
+}
+
+constexpr std::array<std::array<U64, NUM_SQUARES>, NUM_SQUARES> LINE_BB { makeLineBetween(false) };
+constexpr std::array<std::array<U64, NUM_SQUARES>, NUM_SQUARES> BETWEEN_BB { makeLineBetween(true) };
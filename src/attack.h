@@ -1,15 +1,40 @@
 #ifndef ATTACK_H
 #define ATTACK_H
 
-#include "types.h" //U64, NUM_SIDES, NUM_SQUARES, FancyMagic
+#include "types.h" //U64, NUM_SIDES, NUM_SQUARES, FancyMagic, PextEntry
+
+#include <array> // std::array
+#include <cstddef> // std::size_t
+
+#if defined(USE_PEXT)
+#include <immintrin.h> // _pext_u64()
+#endif
 
 namespace Attack
 {
-    void initBishopRookAttacks();
+    inline U64 getRookAttacks(int sq, U64 occupancy);
+    inline U64 getBishopAttacks(int sq, U64 occupancy);
+    inline U64 getQueenAttacks(int sq, U64 occupancy);
+    inline U64 getLine(int sq1, int sq2);
+    inline U64 getBetween(int sq1, int sq2);
 }
 
-inline FancyMagic ROOK_FANCY_MAGICS[NUM_SQUARES] {};
-inline FancyMagic BISHOP_FANCY_MAGICS[NUM_SQUARES] {};
+/*
+ * The slider attack tables and the tables derived from them are generated
+ * at compile time in attack.cpp, so they cost nothing at startup and live
+ * in read-only memory that is shared by all running engine processes.
+ */
+extern const std::array<FancyMagic, NUM_SQUARES> ROOK_FANCY_MAGICS;
+extern const std::array<FancyMagic, NUM_SQUARES> BISHOP_FANCY_MAGICS;
+
+/*
+ * LINE_BB[sq1][sq2] holds the full rank, file or diagonal running through
+ * both squares (edge to edge), and BETWEEN_BB[sq1][sq2] holds the squares
+ * strictly between them. Both are empty if the squares are not aligned.
+ * Used for pin rays and check blocking masks in move generation.
+ */
+extern const std::array<std::array<U64, NUM_SQUARES>, NUM_SQUARES> LINE_BB;
+extern const std::array<std::array<U64, NUM_SQUARES>, NUM_SQUARES> BETWEEN_BB;
 
 /*
  * Pawn Attack Example: White Pawn attack from E2
@@ -63,14 +88,14 @@ inline constexpr U64 PAWN_ATTACKS[NUM_SIDES][NUM_SQUARES] {
  * 0010 0010
  */
 inline constexpr U64 KNIGHT_ATTACKS[NUM_SQUARES] { //knight attacks are color agnostic
-    0x20400ULL, 0x50800ULL, 0xA1100ULL, 0x142200ULL, 0x284400ULL, 0x508800ULL, 0xA01001ULL, 0x402000ULL, 
-    0x2040004ULL, 0x5080008ULL, 0xA110011ULL, 0x14220022ULL, 0x28440044ULL, 0x50880088ULL, 0xA0100110ULL, 0x40200020ULL, 
-    0x204000402ULL, 0x508000805ULL, 0xA1100110AULL, 0x1422002214ULL, 0x2844004428ULL, 0x5088008850ULL, 0xA0100110A0ULL, 0x4020002040ULL, 
-    0x20400040200ULL, 0x50800080500ULL, 0xA1100110A00ULL, 0x142200221400ULL, 0x284400442800ULL, 0x508800885000ULL, 0xA0100110A000ULL, 0x402000204000ULL, 
-    0x2040004020000ULL, 0x5080008050000ULL, 0xA1100110A0000ULL, 0x14220022140000ULL, 0x28440044280000ULL, 0x50880088500000ULL, 0xA0100110A00000ULL, 0x40200020400000ULL, 
-    0x204000402000000ULL, 0x508000805000000ULL, 0xA1100110A000000ULL, 0x1422002214000000ULL, 0x2844004428000000ULL, 0x5088008850000000ULL, 0xA0100110A0000000ULL, 0x4020002040000000ULL, 
-    0x400040200000000ULL, 0x800080500000000ULL, 0x1100110A00000000ULL, 0x2200221400000000ULL, 0x4400442800000000ULL, 0x8800885000000000ULL, 0x100110A000000000ULL, 0x2000204000000000ULL, 
-    0x4020000000000ULL, 0x8050000000000ULL, 0x110A0000000000ULL, 0x22140000000000ULL, 0x44280000000000ULL, 0x88500000000000ULL, 0x110A00000000000ULL, 0x20400000000000ULL
+    0x20400ULL, 0x50800ULL, 0xA1100ULL, 0x142200ULL, 0x284400ULL, 0x508800ULL, 0xA01000ULL, 0x402000ULL, 
+    0x2040004ULL, 0x5080008ULL, 0xA110011ULL, 0x14220022ULL, 0x28440044ULL, 0x50880088ULL, 0xA0100010ULL, 0x40200020ULL, 
+    0x204000402ULL, 0x508000805ULL, 0xA1100110AULL, 0x1422002214ULL, 0x2844004428ULL, 0x5088008850ULL, 0xA0100010A0ULL, 0x4020002040ULL, 
+    0x20400040200ULL, 0x50800080500ULL, 0xA1100110A00ULL, 0x142200221400ULL, 0x284400442800ULL, 0x508800885000ULL, 0xA0100010A000ULL, 0x402000204000ULL, 
+    0x2040004020000ULL, 0x5080008050000ULL, 0xA1100110A0000ULL, 0x14220022140000ULL, 0x28440044280000ULL, 0x50880088500000ULL, 0xA0100010A00000ULL, 0x40200020400000ULL, 
+    0x204000402000000ULL, 0x508000805000000ULL, 0xA1100110A000000ULL, 0x1422002214000000ULL, 0x2844004428000000ULL, 0x5088008850000000ULL, 0xA0100010A0000000ULL, 0x4020002040000000ULL, 
+    0x400040200000000ULL, 0x800080500000000ULL, 0x1100110A00000000ULL, 0x2200221400000000ULL, 0x4400442800000000ULL, 0x8800885000000000ULL, 0x100010A000000000ULL, 0x2000204000000000ULL, 
+    0x4020000000000ULL, 0x8050000000000ULL, 0x110A0000000000ULL, 0x22140000000000ULL, 0x44280000000000ULL, 0x88500000000000ULL, 0x10A00000000000ULL, 0x20400000000000ULL
 };
 
 /*
@@ -175,7 +200,7 @@ inline constexpr int BISHOP_SHIFT[64] = {
  * 20x 4-bit = 20 x 2^4 = 20 x 16 = 320
  * Total = 4800 = 0x12C0
  */
-inline U64 BISHOP_ATTACKS_TABLE[0x12C0] {};
+extern const std::array<U64, 0x12C0> BISHOP_ATTACKS_TABLE;
 
 /*
  * Occupancy is used to denote relevant squares that could potentially
@@ -254,6 +279,81 @@ inline constexpr int ROOK_SHIFT[NUM_SQUARES] = {
  * 2x 12-bit = 2 x 2^12 = 2 x 4096 = 8192
  * Total = 90624 = 0x16200
  */
-inline U64 ROOK_ATTACKS_TABLE[0x16200] {};
+extern const std::array<U64, 0x16200> ROOK_ATTACKS_TABLE;
+
+#if defined(USE_PEXT)
+extern const std::array<PextEntry, NUM_SQUARES> ROOK_PEXT;
+extern const std::array<PextEntry, NUM_SQUARES> BISHOP_PEXT;
+
+/*
+ * PEXT indices are dense, so every square needs exactly 2^(relevant occupancy bits)
+ * entries, slightly more in total than the overlapping Texel magics.
+ * 
+ * Rook: 4x 12-bit + 24x 11-bit + 36x 10-bit = 16384 + 49152 + 36864 = 102400 = 0x19000
+ * Bishop: 4x 6-bit + 44x 5-bit + 12x 7-bit + 4x 9-bit = 256 + 1408 + 1536 + 2048 = 5248 = 0x1480
+ */
+extern const std::array<U64, 0x19000> ROOK_PEXT_ATTACKS_TABLE;
+extern const std::array<U64, 0x1480> BISHOP_PEXT_ATTACKS_TABLE;
+
+/*
+ * Look up the attacks of a rook on sq for a given board occupancy.
+ * PEXT gathers the relevant occupancy bits into the low bits of the index.
+ */
+inline U64 Attack::getRookAttacks(int sq, U64 occupancy)
+{
+    const PextEntry& entry = ROOK_PEXT[static_cast<std::size_t>(sq)];
+    return entry.attackTablePointer[_pext_u64(occupancy, entry.occupancyMask)];
+}
+
+/*
+ * Look up the attacks of a bishop on sq for a given board occupancy.
+ */
+inline U64 Attack::getBishopAttacks(int sq, U64 occupancy)
+{
+    const PextEntry& entry = BISHOP_PEXT[static_cast<std::size_t>(sq)];
+    return entry.attackTablePointer[_pext_u64(occupancy, entry.occupancyMask)];
+}
+#else
+/*
+ * Look up the attacks of a rook on sq for a given board occupancy.
+ * Only the relevant occupancy bits are kept, multiplied with the
+ * magic number and shifted down to index into the attack table.
+ */
+inline U64 Attack::getRookAttacks(int sq, U64 occupancy)
+{
+    const FancyMagic& magic = ROOK_FANCY_MAGICS[static_cast<std::size_t>(sq)];
+    return magic.attackTablePointer[((occupancy & magic.occupancyMask) * magic.magicNumber) >> magic.shift];
+}
+
+/*
+ * Look up the attacks of a bishop on sq for a given board occupancy.
+ */
+inline U64 Attack::getBishopAttacks(int sq, U64 occupancy)
+{
+    const FancyMagic& magic = BISHOP_FANCY_MAGICS[static_cast<std::size_t>(sq)];
+    return magic.attackTablePointer[((occupancy & magic.occupancyMask) * magic.magicNumber) >> magic.shift];
+}
+#endif
+
+/*
+ * Look up LINE_BB and BETWEEN_BB by LERFSquare.
+ */
+inline U64 Attack::getLine(int sq1, int sq2)
+{
+    return LINE_BB[static_cast<std::size_t>(sq1)][static_cast<std::size_t>(sq2)];
+}
+
+inline U64 Attack::getBetween(int sq1, int sq2)
+{
+    return BETWEEN_BB[static_cast<std::size_t>(sq1)][static_cast<std::size_t>(sq2)];
+}
+
+/*
+ * A queen attacks as the union of a rook and a bishop on the same square.
+ */
+inline U64 Attack::getQueenAttacks(int sq, U64 occupancy)
+{
+    return getRookAttacks(sq, occupancy) | getBishopAttacks(sq, occupancy);
+}
 
 #endif
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include "bench.h"
+#include "move.h" // Move, MoveList, moveFrom(), moveTo()
+#include "movegen.h" // MoveGen::generateLegalMoves()
+#include "nnue.h" // Accumulator, NNUE::isLoaded(), NNUE::refresh(), NNUE::movePiece(), NNUE::evaluate()
+#include "position.h" // Position, FenError, FEN_BUFFER_SIZE, STANDARD_START_FEN
+#include "prng.h" // PRNG
+#include "types.h" // U64, Piece, NUM_SQUARES
+#include "uci.h" // uciOutput()
+
+#include <chrono> // std::chrono::steady_clock, std::chrono::duration_cast
+#include <cstddef> // std::size_t
+#include <fstream> // std::ifstream
+#include <iomanip> // std::setprecision()
+#include <iterator> // std::istreambuf_iterator
+#include <sstream> // std::ostringstream
+#include <string> // std::string, std::to_string()
+#include <string_view> // std::string_view
+#include <vector> // std::vector
+
+/*
+ * Fill corpus with FENs of the positions of random games from the start position,
+ * one FEN per line. A game ends at mate, stalemate or after 200 plies.
+ */
+void generateFenCorpus(int numPositions, std::string& corpus)
+{
+    constexpr int MAX_GAME_LENGTH { 200 };
+    PRNG randGen { 0x8A1C4E3B27D90F65ULL };
+    Position position {};
+    char fen[FEN_BUFFER_SIZE] {};
+    MoveList moveList;
+
+    for(int count { 0 }; count < numPositions; ++count)
+    {
+        MoveGen::generateLegalMoves(position, moveList);
+        if(moveList.size() == 0 || position.getPly() >= MAX_GAME_LENGTH)
+        {
+            position.setFromFen(STANDARD_START_FEN);
+            MoveGen::generateLegalMoves(position, moveList);
+        }
+        position.makeMove(moveList.moves[randGen.xorShiftRand() % static_cast<U64>(moveList.size())]);
+
+        corpus.append(fen, position.toFen(fen, FEN_BUFFER_SIZE));
+        corpus += '\n';
+    }
+}
+
+/*
+ * fenbench [positions <x>] [file <path>]
+ * Measure FEN parsing and writing speed. The corpus is read from a file with one FEN
+ * per line, or generated from random games. Each pass parses every FEN with
+ * Position::setFromFen() and writes it back with Position::toFen(), passes are
+ * repeated for at least a second. Also reports FENs that fail to parse or do not
+ * round trip to the same Zobrist key.
+ */
+void Bench::runFenBench(int numPositions, const std::string& fileName)
+{
+    std::string corpus {};
+    if(!fileName.empty())
+    {
+        std::ifstream file { fileName, std::ios::binary };
+        if(!file)
+        {
+            uciOutput("info string Cannot open " + fileName);
+            return;
+        }
+        corpus.assign(std::istreambuf_iterator<char> { file }, std::istreambuf_iterator<char> {});
+    }
+    else
+    {
+        generateFenCorpus(numPositions, corpus);
+    }
+
+    std::vector<std::string_view> fens {};
+    std::string_view remaining { corpus };
+    while(!remaining.empty())
+    {
+        std::size_t lineEnd { std::min(remaining.find('\n'), remaining.size()) };
+        std::string_view line { remaining.substr(0, lineEnd) };
+        if(!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        if(!line.empty())
+            fens.push_back(line);
+        remaining.remove_prefix(std::min(lineEnd + 1, remaining.size()));
+    }
+    if(fens.empty())
+        return;
+
+    // Validate once, counting errors and round trip mismatches
+    Position position {};
+    Position roundTrip {};
+    char fen[FEN_BUFFER_SIZE] {};
+    int parseErrors { 0 };
+    int roundTripErrors { 0 };
+    for(std::string_view line : fens)
+    {
+        if(position.setFromFen(line) != FenError::NONE)
+        {
+            ++parseErrors;
+            continue;
+        }
+        std::size_t length { position.toFen(fen, FEN_BUFFER_SIZE) };
+        if(roundTrip.setFromFen(std::string_view { fen, length }) != FenError::NONE
+            || roundTrip.getPositionIdentity() != position.getPositionIdentity())
+        {
+            ++roundTripErrors;
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+    constexpr long long MIN_BENCH_MILLISECONDS { 1000 };
+    auto elapsedMilliseconds = [](Clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    };
+
+    // Parsing
+    U64 parsed { 0 };
+    U64 checksum { 0 };
+    const Clock::time_point parseStart { Clock::now() };
+    do
+    {
+        for(std::string_view line : fens)
+        {
+            position.setFromFen(line);
+            checksum ^= position.getPositionIdentity();
+        }
+        parsed += fens.size();
+    } while(elapsedMilliseconds(parseStart) < MIN_BENCH_MILLISECONDS);
+    const long long parseMilliseconds { elapsedMilliseconds(parseStart) };
+
+    // Writing, from positions parsed up front
+    std::vector<Position> positions(std::min<std::size_t>(fens.size(), 1024), position);
+    for(std::size_t i { 0 }; i < positions.size(); ++i)
+        positions[i].setFromFen(fens[i]);
+    U64 written { 0 };
+    const Clock::time_point writeStart { Clock::now() };
+    do
+    {
+        for(const Position& writePosition : positions)
+            checksum += writePosition.toFen(fen, FEN_BUFFER_SIZE);
+        written += positions.size();
+    } while(elapsedMilliseconds(writeStart) < MIN_BENCH_MILLISECONDS);
+    const long long writeMilliseconds { elapsedMilliseconds(writeStart) };
+
+    uciOutput("\nFENs in corpus: " + std::to_string(fens.size()));
+    uciOutput("Parse errors: " + std::to_string(parseErrors));
+    uciOutput("Round trip errors: " + std::to_string(roundTripErrors));
+    uciOutput("FENs parsed per second: " + std::to_string(parsed * 1000 / static_cast<U64>(parseMilliseconds)));
+    uciOutput("FENs written per second: " + std::to_string(written * 1000 / static_cast<U64>(writeMilliseconds)));
+    uciOutput("Checksum: " + std::to_string(checksum));
+}
+
+/*
+ * A position of the NNUE benchmark, and a random legal move in it.
+ */
+struct NnueSample
+{
+    Piece board[NUM_SQUARES];
+    Piece piece;
+    int from;
+    int to;
+};
+
+/*
+ * nnuebench [positions <x>]
+ * Measure the cost of a full accumulator refresh, of an incremental update
+ * for one moved piece (as done by makeMove() for a quiet move), and of the
+ * output layer, over positions from random games. Each measurement is
+ * repeated for at least a second.
+ */
+void Bench::runNnueBench(int numPositions)
+{
+    if(!NNUE::isLoaded())
+    {
+        uciOutput("info string No network loaded, set EvalFile first");
+        return;
+    }
+
+    constexpr int MAX_GAME_LENGTH { 200 };
+    PRNG randGen { 0x8A1C4E3B27D90F65ULL };
+    Position position {};
+    MoveList moveList;
+    std::vector<NnueSample> samples(static_cast<std::size_t>(numPositions));
+    for(NnueSample& sample : samples)
+    {
+        MoveGen::generateLegalMoves(position, moveList);
+        if(moveList.size() == 0 || position.getPly() >= MAX_GAME_LENGTH)
+        {
+            position.setFromFen(STANDARD_START_FEN);
+            MoveGen::generateLegalMoves(position, moveList);
+        }
+        const Move move { moveList.moves[randGen.xorShiftRand() % static_cast<U64>(moveList.size())] };
+        for(int sq { A1 }; sq < NUM_SQUARES; ++sq)
+            sample.board[sq] = position.pieceOn(sq);
+        sample.piece = position.pieceOn(moveFrom(move));
+        sample.from = moveFrom(move);
+        sample.to = moveTo(move);
+        position.makeMove(move);
+    }
+
+    using Clock = std::chrono::steady_clock;
+    constexpr long long MIN_BENCH_MILLISECONDS { 1000 };
+    auto elapsedNanoseconds = [](Clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    };
+
+    Accumulator accumulator {};
+    int checksum { 0 };
+
+    // Full refresh
+    U64 refreshes { 0 };
+    const Clock::time_point refreshStart { Clock::now() };
+    do
+    {
+        for(const NnueSample& sample : samples)
+        {
+            NNUE::refresh(accumulator, sample.board);
+            checksum += accumulator.values[WHITE][0];
+        }
+        refreshes += samples.size();
+    } while(elapsedNanoseconds(refreshStart) < MIN_BENCH_MILLISECONDS * 1000000);
+    const double refreshNanoseconds { static_cast<double>(elapsedNanoseconds(refreshStart)) / static_cast<double>(refreshes) };
+
+    // Incremental update, moving a piece there and back
+    U64 updates { 0 };
+    const Clock::time_point updateStart { Clock::now() };
+    do
+    {
+        for(const NnueSample& sample : samples)
+        {
+            NNUE::movePiece(accumulator, sample.piece, sample.from, sample.to);
+            NNUE::movePiece(accumulator, sample.piece, sample.to, sample.from);
+            checksum += accumulator.values[WHITE][0];
+        }
+        updates += 2 * samples.size();
+    } while(elapsedNanoseconds(updateStart) < MIN_BENCH_MILLISECONDS * 1000000);
+    const double updateNanoseconds { static_cast<double>(elapsedNanoseconds(updateStart)) / static_cast<double>(updates) };
+
+    // Output layer
+    U64 evaluations { 0 };
+    const Clock::time_point evaluateStart { Clock::now() };
+    do
+    {
+        for(std::size_t i { 0 }; i < samples.size(); ++i)
+            checksum += NNUE::evaluate(accumulator, i % 2 ? BLACK : WHITE);
+        evaluations += samples.size();
+    } while(elapsedNanoseconds(evaluateStart) < MIN_BENCH_MILLISECONDS * 1000000);
+    const double evaluateNanoseconds { static_cast<double>(elapsedNanoseconds(evaluateStart)) / static_cast<double>(evaluations) };
+
+    std::ostringstream report {};
+    report << std::fixed << std::setprecision(1)
+           << "\nPositions: " << samples.size()
+           << "\nFull refresh (ns): " << refreshNanoseconds
+           << "\nIncremental update (ns): " << updateNanoseconds
+           << "\nRefresh / update: " << refreshNanoseconds / updateNanoseconds
+           << "\nEvaluation (ns): " << evaluateNanoseconds
+           << "\nChecksum: " << checksum;
+    uciOutput(report.str());
+}
@@ -0,0 +1,12 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string> // std::string
+
+namespace Bench
+{
+    void runFenBench(int numPositions, const std::string& fileName);
+    void runNnueBench(int numPositions);
+}
+
+#endif
@@ -1,11 +1,178 @@
 #ifndef BITBOARD_H
 #define BITBOARD_H
 
-#include "types.h" // U64 
+#include "types.h" // U64, RayDirection
 
-int popcount(U64 bitboard);
-U64 resetBit(U64 bitboard, int sq);
-U64 setBit(U64 bitboard, int sq);
-U64 squareToBitboard(int sq);
+#include <bit> // std::popcount(), std::countr_zero(), std::countl_zero()
 
-#endif
\ No newline at end of file
+inline constexpr U64 FILE_A_BB { 0x0101010101010101ULL };
+inline constexpr U64 FILE_H_BB { 0x8080808080808080ULL };
+inline constexpr U64 RANK_1_BB { 0xFFULL };
+inline constexpr U64 RANK_2_BB { 0xFF00ULL };
+inline constexpr U64 RANK_3_BB { 0xFF0000ULL };
+inline constexpr U64 RANK_6_BB { 0xFF0000000000ULL };
+inline constexpr U64 RANK_7_BB { 0xFF000000000000ULL };
+inline constexpr U64 RANK_8_BB { 0xFF00000000000000ULL };
+
+/*
+ * All bitboard helpers are header-only and constexpr, so they inline into
+ * the move generation and evaluation loops. The bit scans map to single
+ * POPCNT/TZCNT/LZCNT instructions when built for a CPU that has them
+ * (see ARCH in the Makefile), and to compiler builtins otherwise.
+ */
+
+/*
+ * Count number of set bits in bitboard.
+ */
+constexpr int popcount(U64 bitboard)
+{
+    return std::popcount(bitboard);
+}
+
+/*
+ * Return the LERFSquare index of the least significant
+ * set bit. The bitboard must not be empty.
+ */
+constexpr int lsbIndex(U64 bitboard)
+{
+    return std::countr_zero(bitboard);
+}
+
+/*
+ * Return the LERFSquare index of the most significant
+ * set bit. The bitboard must not be empty.
+ */
+constexpr int msbIndex(U64 bitboard)
+{
+    return 63 - std::countl_zero(bitboard);
+}
+
+/*
+ * Return the LERFSquare index of the least significant
+ * set bit, and reset that bit in the bitboard.
+ * The bitboard must not be empty.
+ */
+constexpr int popLSB(U64& bitboard)
+{
+    int sq { lsbIndex(bitboard) };
+    bitboard &= bitboard - 1;
+    return sq;
+}
+
+/*
+ * Return true if more than one bit is set, without counting them.
+ */
+constexpr bool moreThanOne(U64 bitboard)
+{
+    return bitboard & (bitboard - 1);
+}
+
+/*
+ * Take in a LERFSquare, and return a U64
+ * bitboard with the relevant square bit set.
+ */
+constexpr U64 squareToBitboard(int sq)
+{
+    return (1ULL << sq);
+}
+
+/*
+ * Take in a bitboard and square, and
+ * set the square bit to 0.
+ */
+constexpr U64 resetBit(U64 bitboard, int sq)
+{
+    return bitboard & ~squareToBitboard(sq);
+}
+
+/*
+ * Take in a bitboard and square, and
+ * set the square bit to 1.
+ */
+constexpr U64 setBit(U64 bitboard, int sq)
+{
+    return bitboard | squareToBitboard(sq);
+}
+
+/*
+ * Shift all bits of a bitboard one step in a ray direction.
+ * Bits shifted over the A or H file edge are dropped instead of
+ * wrapping around to the other side of the board.
+ */
+template<RayDirection Direction>
+constexpr U64 shift(U64 bitboard)
+{
+    if constexpr(Direction == NORTH) return bitboard << 8;
+    else if constexpr(Direction == SOUTH) return bitboard >> 8;
+    else if constexpr(Direction == EAST) return (bitboard & ~FILE_H_BB) << 1;
+    else if constexpr(Direction == WEST) return (bitboard & ~FILE_A_BB) >> 1;
+    else if constexpr(Direction == NORTH_EAST) return (bitboard & ~FILE_H_BB) << 9;
+    else if constexpr(Direction == NORTH_WEST) return (bitboard & ~FILE_A_BB) << 7;
+    else if constexpr(Direction == SOUTH_EAST) return (bitboard & ~FILE_H_BB) >> 7;
+    else return (bitboard & ~FILE_A_BB) >> 9;
+}
+
+/*
+ * Smear every set bit towards the 8th rank, including the bit itself.
+ * Kogge-Stone style parallel prefix with three shifts.
+ */
+constexpr U64 northFill(U64 bitboard)
+{
+    bitboard |= bitboard << 8;
+    bitboard |= bitboard << 16;
+    bitboard |= bitboard << 32;
+    return bitboard;
+}
+
+/*
+ * Smear every set bit towards the 1st rank, including the bit itself.
+ */
+constexpr U64 southFill(U64 bitboard)
+{
+    bitboard |= bitboard >> 8;
+    bitboard |= bitboard >> 16;
+    bitboard |= bitboard >> 32;
+    return bitboard;
+}
+
+/*
+ * Set every square of every file that has a bit set.
+ */
+constexpr U64 fileFill(U64 bitboard)
+{
+    return northFill(bitboard) | southFill(bitboard);
+}
+
+/*
+ * Forward iterator over the LERFSquare indices of the set bits of a
+ * bitboard, from least to most significant. Incrementing resets the LS1B,
+ * so iterating compiles to the same TZCNT/BLSR loop as popLSB().
+ */
+class SquareIterator
+{
+    private:
+        U64 bitboard;
+    public:
+        constexpr explicit SquareIterator(U64 bb) : bitboard { bb } {}
+        constexpr int operator*() const { return lsbIndex(this->bitboard); }
+        constexpr SquareIterator& operator++() { this->bitboard &= this->bitboard - 1; return *this; }
+        constexpr bool operator!=(const SquareIterator& other) const { return this->bitboard != other.bitboard; }
+};
+
+/*
+ * Range over the set squares of a bitboard, e.g.
+ *     for(int sq : squaresOf(knights)) { ... }
+ */
+struct SquareRange
+{
+    U64 bitboard;
+    constexpr SquareIterator begin() const { return SquareIterator { this->bitboard }; }
+    constexpr SquareIterator end() const { return SquareIterator { 0ULL }; }
+};
+
+constexpr SquareRange squaresOf(U64 bitboard)
+{
+    return SquareRange { bitboard };
+}
+
+#endif
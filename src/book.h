@@ -0,0 +1,25 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include "move.h" // Move
+#include "position.h" // Position
+#include "types.h" // U64
+
+#include <string> // std::string
+
+/*
+ * Polyglot opening book. The .bin file is a sequence of 16 byte entries
+ * sorted by position key, so it is memory mapped and binary searched in place,
+ * however large the book is.
+ */
+namespace Book
+{
+    bool open(const std::string& fileName);
+    void close();
+    bool isOpen();
+
+    U64 polyglotKey(const Position& position);
+    Move probe(const Position& position);
+}
+
+#endif
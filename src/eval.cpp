@@ -0,0 +1,31 @@
+#include "eval.h"
+#include "nnue.h" // NNUE::isLoaded(), NNUE::evaluate()
+#include "pawns.h" // PawnTable, PawnEntry, Pawns::kingShelter()
+#include "position.h" // Position
+#include "psqt.h" // MAX_GAME_PHASE
+#include "types.h" // WHITE, BLACK
+
+#include <algorithm> // std::min()
+
+/*
+ * Static evaluation in centipawns from the point of view of the side to move.
+ * With a network loaded (EvalFile) the NNUE evaluation is used. Otherwise
+ * tapered material and piece-square evaluation plus pawn structure: the
+ * middlegame and endgame scores and the game phase are maintained incrementally
+ * by Position, the pawn structure comes from the pawn hash table of the calling
+ * thread, so this is mostly an interpolation between the two scores by the phase.
+ */
+int Eval::evaluate(const Position& position, PawnTable& pawnTable)
+{
+    if(NNUE::isLoaded())
+        return NNUE::evaluate(position.getAccumulator(), position.getSideToMove());
+
+    PawnEntry& pawnEntry = pawnTable.probe(position);
+    const int midgame { position.getMidgameScore() + pawnEntry.midgameScore
+                        + Pawns::kingShelter(pawnEntry, position, WHITE) - Pawns::kingShelter(pawnEntry, position, BLACK) };
+    const int endgame { position.getEndgameScore() + pawnEntry.endgameScore };
+
+    const int phase { std::min(position.getGamePhase(), MAX_GAME_PHASE) };
+    const int score { (midgame * phase + endgame * (MAX_GAME_PHASE - phase)) / MAX_GAME_PHASE };
+    return position.getSideToMove() == WHITE ? score : -score;
+}
@@ -0,0 +1,19 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include "pawns.h" // PawnTable
+#include "position.h" // Position
+#include "types.h" // NUM_PIECE_TYPES
+
+/*
+ * Centipawn piece values indexed by PieceType.
+ * The king is given no material value, it can never be captured.
+ */
+inline constexpr int PIECE_VALUES[NUM_PIECE_TYPES] { 0, 100, 320, 330, 500, 900, 0 };
+
+namespace Eval
+{
+    int evaluate(const Position& position, PawnTable& pawnTable);
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include "mappedfile.h"
+
+#include <cstddef> // std::size_t
+#include <fstream> // std::ifstream
+#include <iterator> // std::istreambuf_iterator
+#include <string> // std::string
+#include <string_view> // std::string_view
+
+#if defined(__unix__) || defined(__APPLE__)
+#define USE_MMAP
+#include <fcntl.h> // open(), O_RDONLY
+#include <sys/mman.h> // mmap(), munmap(), madvise()
+#include <sys/stat.h> // fstat()
+#include <unistd.h> // close()
+#endif
+
+MappedFile::~MappedFile()
+{
+    this->close();
+}
+
+/*
+ * Map fileName into memory, replacing any file mapped before.
+ * Return false if the file cannot be opened or is empty.
+ */
+bool MappedFile::open(const std::string& fileName, bool randomAccess)
+{
+    this->close();
+
+#if defined(USE_MMAP)
+    int fd { ::open(fileName.c_str(), O_RDONLY) };
+    if(fd == -1)
+        return false;
+
+    struct stat fileStatus {};
+    if(fstat(fd, &fileStatus) == -1 || fileStatus.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    std::size_t size { static_cast<std::size_t>(fileStatus.st_size) };
+    void* address { mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) };
+    ::close(fd);
+    if(address == MAP_FAILED)
+        return false;
+
+#if defined(MADV_SEQUENTIAL) && defined(MADV_RANDOM)
+    madvise(address, size, randomAccess ? MADV_RANDOM : MADV_SEQUENTIAL);
+#endif
+    this->mapping = static_cast<const char*>(address);
+    this->mappingSize = size;
+#else
+    std::ifstream file { fileName, std::ios::binary };
+    if(!file)
+        return false;
+    this->buffer.assign(std::istreambuf_iterator<char> { file }, std::istreambuf_iterator<char> {});
+    static_cast<void>(randomAccess);
+#endif
+
+    return this->isOpen();
+}
+
+void MappedFile::close()
+{
+#if defined(USE_MMAP)
+    if(this->mapping)
+        munmap(const_cast<char*>(this->mapping), this->mappingSize);
+#endif
+    this->mapping = nullptr;
+    this->mappingSize = 0;
+    this->buffer.clear();
+}
+
+std::string_view MappedFile::view() const
+{
+    if(this->mapping)
+        return std::string_view { this->mapping, this->mappingSize };
+    return std::string_view { this->buffer.data(), this->buffer.size() };
+}
@@ -0,0 +1,34 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef> // std::size_t
+#include <string> // std::string
+#include <string_view> // std::string_view
+#include <vector> // std::vector
+
+/*
+ * Read only view of a whole file. On POSIX systems the file is mapped into memory,
+ * so opening it costs no copy and the OS pages it in as it is read.
+ * Elsewhere the file is read into a buffer instead.
+ * Files read in scattered small pieces, like tablebases, should be opened
+ * with randomAccess, so the OS does not read ahead around every access.
+ */
+class MappedFile
+{
+    private:
+        const char* mapping { nullptr };
+        std::size_t mappingSize { 0 };
+        std::vector<char> buffer {};
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile();
+
+        bool open(const std::string& fileName, bool randomAccess = false);
+        void close();
+        bool isOpen() const { return this->mapping != nullptr || !this->buffer.empty(); }
+        std::string_view view() const;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#include "move.h"
+#include "position.h" // fileToChar, rankToChar
+#include "types.h" // NUM_FILES, NUM_RANKS
+
+#include <string> // std::string
+
+/*
+ * Convert a move to long algebraic notation as used by UCI,
+ * e.g. "e2e4", "e7e8q". The null move is written as "0000".
+ */
+std::string moveToString(Move move)
+{
+    if(move == NO_MOVE)
+        return "0000";
+
+    std::string moveString {};
+    moveString += fileToChar[static_cast<std::size_t>(moveFrom(move) % NUM_FILES)];
+    moveString += rankToChar[static_cast<std::size_t>(moveFrom(move) / NUM_RANKS)];
+    moveString += fileToChar[static_cast<std::size_t>(moveTo(move) % NUM_FILES)];
+    moveString += rankToChar[static_cast<std::size_t>(moveTo(move) / NUM_RANKS)];
+
+    if(isPromotion(move))
+    {
+        // Use the lowercase (black) piece characters, as UCI expects
+        moveString += pieceToChar[static_cast<std::size_t>(makePiece(BLACK, promotionType(move)))];
+    }
+    return moveString;
+}
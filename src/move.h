@@ -0,0 +1,101 @@
+#ifndef MOVE_H
+#define MOVE_H
+
+#include "types.h" // PieceType
+
+#include <cassert> // assert()
+#include <cstdint> // std::uint16_t
+#include <string> // std::string
+
+/*
+ * Moves are encoded into 16 bits:
+ * 
+ * bits  0-5   from square (LERFSquare)
+ * bits  6-11  to square (LERFSquare)
+ * bits 12-15  move flag (MoveFlag)
+ * 
+ * The flag layout follows the "From-To based" encoding, where bit 14 (flag value 4)
+ * marks captures and bit 15 (flag value 8) marks promotions. See
+ * https://www.chessprogramming.org/Encoding_Moves#From-To_Based
+ */
+using Move = std::uint16_t;
+
+inline constexpr Move NO_MOVE { 0 };
+
+enum MoveFlag : int
+{
+    QUIET_MOVE, DOUBLE_PAWN_PUSH, KING_CASTLE, QUEEN_CASTLE,
+    CAPTURE, EN_PASSANT_CAPTURE,
+    KNIGHT_PROMOTION = 8, BISHOP_PROMOTION, ROOK_PROMOTION, QUEEN_PROMOTION,
+    KNIGHT_PROMOTION_CAPTURE, BISHOP_PROMOTION_CAPTURE, ROOK_PROMOTION_CAPTURE, QUEEN_PROMOTION_CAPTURE
+};
+
+constexpr Move encodeMove(int from, int to, int flag)
+{
+    return static_cast<Move>(from | (to << 6) | (flag << 12));
+}
+
+constexpr int moveFrom(Move move)
+{
+    return move & 0x3F;
+}
+
+constexpr int moveTo(Move move)
+{
+    return (move >> 6) & 0x3F;
+}
+
+constexpr int moveFlag(Move move)
+{
+    return move >> 12;
+}
+
+constexpr bool isCapture(Move move)
+{
+    return moveFlag(move) & CAPTURE;
+}
+
+constexpr bool isPromotion(Move move)
+{
+    return moveFlag(move) & KNIGHT_PROMOTION;
+}
+
+/*
+ * The two low flag bits of a promotion select the piece,
+ * from knight (0) to queen (3).
+ */
+constexpr PieceType promotionType(Move move)
+{
+    return static_cast<PieceType>(KNIGHT + (moveFlag(move) & 3));
+}
+
+std::string moveToString(Move move);
+
+/*
+ * Fixed capacity list of moves, meant to live on the stack of the caller.
+ * 256 exceeds the maximum number of legal moves in any reachable chess position (218).
+ * The move array is deliberately left uninitialized, only the first count entries are valid,
+ * the user-provided constructor keeps it that way for value-initialized lists too.
+ */
+inline constexpr int MAX_MOVES { 256 };
+
+struct MoveList
+{
+    Move moves[MAX_MOVES];
+    int count { 0 };
+
+    MoveList() {}
+
+    void add(Move move)
+    {
+        assert(this->count < MAX_MOVES);
+        this->moves[this->count++] = move;
+    }
+    int size() const { return this->count; }
+    Move* begin() { return this->moves; }
+    Move* end() { return this->moves + this->count; }
+    const Move* begin() const { return this->moves; }
+    const Move* end() const { return this->moves + this->count; }
+};
+
+#endif
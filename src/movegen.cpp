@@ -0,0 +1,368 @@
+#include "attack.h" // PAWN_ATTACKS, KNIGHT_ATTACKS, KING_ATTACKS, Attack::getLine(), Attack::getBetween(), Attack::getRookAttacks(), Attack::getBishopAttacks(), Attack::getQueenAttacks()
+#include "bitboard.h" // squareToBitboard(), squaresOf(), lsbIndex(), moreThanOne(), RANK_1_BB, RANK_2_BB, RANK_7_BB, RANK_8_BB
+#include "move.h" // Move, MoveList, MoveFlag, encodeMove(), moveFrom(), moveTo(), moveFlag(), isCapture(), isPromotion()
+#include "movegen.h"
+#include "position.h" // Position
+#include "types.h" // U64, Piece, PieceType, Side, LERFSquare, Castle
+
+/*
+ * Add a move for every square in targets, flagging it as
+ * a capture if the target square holds an enemy piece.
+ */
+void addPieceMoves(MoveList& moveList, int from, U64 targets, U64 enemyPieces)
+{
+    for(int to : squaresOf(targets))
+    {
+        int flag { (enemyPieces & squareToBitboard(to)) ? CAPTURE : QUIET_MOVE };
+        moveList.add(encodeMove(from, to, flag));
+    }
+}
+
+/*
+ * Add the promotions of a pawn move: the queen promotion is a noisy move,
+ * the three underpromotions count as quiet moves, whether they capture or not.
+ */
+template<GenType Type>
+void addPromotions(MoveList& moveList, int from, int to, bool capture)
+{
+    int captureFlag { capture ? CAPTURE : QUIET_MOVE };
+    if(Type != QUIET_MOVES)
+        moveList.add(encodeMove(from, to, QUEEN_PROMOTION | captureFlag));
+    if(Type != NOISY_MOVES)
+    {
+        moveList.add(encodeMove(from, to, KNIGHT_PROMOTION | captureFlag));
+        moveList.add(encodeMove(from, to, ROOK_PROMOTION | captureFlag));
+        moveList.add(encodeMove(from, to, BISHOP_PROMOTION | captureFlag));
+    }
+}
+
+/*
+ * Squares pieces may move to for a generation type.
+ */
+template<GenType Type>
+constexpr U64 targetSquares(U64 ourPieces, U64 enemyPieces)
+{
+    if(Type == NOISY_MOVES)
+        return enemyPieces;
+    if(Type == QUIET_MOVES)
+        return ~(ourPieces | enemyPieces);
+    return ~ourPieces;
+}
+
+/*
+ * Generate all pawn moves for side us, restricted to checkMask
+ * and to the pin ray of pinned pawns. En passant captures are verified
+ * separately by testing the king for slider attacks with both pawns removed,
+ * which catches the rare horizontal pin through two pawns on the same rank.
+ */
+template<GenType Type>
+void generatePawnMoves(const Position& position, MoveList& moveList, int kingSq, U64 pinned, U64 checkMask)
+{
+    const Side us { position.getSideToMove() };
+    const Side them { oppositeSide(us) };
+    const U64 enemyPieces { position.getPieceBitboard(sideAllPieces(them)) };
+    const U64 occupancy { position.getPieceBitboard(ALL_PIECES) };
+    const int pushDirection { us == WHITE ? NORTH : SOUTH };
+    const U64 startRank { us == WHITE ? RANK_2_BB : RANK_7_BB };
+    const U64 promotionRank { us == WHITE ? RANK_8_BB : RANK_1_BB };
+    const LERFSquare enPassantSquare { position.getEnPassantSquare() };
+
+    for(int from : squaresOf(position.getPieceBitboard(makePiece(us, PAWN))))
+    {
+        U64 fromBB { squareToBitboard(from) };
+        U64 legalMask { (pinned & fromBB) ? (checkMask & Attack::getLine(kingSq, from)) : checkMask };
+
+        // Single and double pushes
+        int to { from + pushDirection };
+        U64 toBB { squareToBitboard(to) };
+        if(!(occupancy & toBB))
+        {
+            if(legalMask & toBB)
+            {
+                if(promotionRank & toBB)
+                    addPromotions<Type>(moveList, from, to, false);
+                else if(Type != NOISY_MOVES)
+                    moveList.add(encodeMove(from, to, QUIET_MOVE));
+            }
+
+            // Only pawns on their start rank have a square two ranks ahead to look at,
+            // for others it may lie off the board
+            if(Type != NOISY_MOVES && (startRank & fromBB))
+            {
+                int doubleTo { to + pushDirection };
+                U64 doubleToBB { squareToBitboard(doubleTo) };
+                if(!(occupancy & doubleToBB) && (legalMask & doubleToBB))
+                    moveList.add(encodeMove(from, doubleTo, DOUBLE_PAWN_PUSH));
+            }
+        }
+
+        // Captures
+        for(int captureTo : squaresOf(PAWN_ATTACKS[us][from] & enemyPieces & legalMask))
+        {
+            if(promotionRank & squareToBitboard(captureTo))
+                addPromotions<Type>(moveList, from, captureTo, true);
+            else if(Type != QUIET_MOVES)
+                moveList.add(encodeMove(from, captureTo, CAPTURE));
+        }
+
+        // En passant
+        if(Type != QUIET_MOVES && enPassantSquare != NO_SQ && (PAWN_ATTACKS[us][from] & squareToBitboard(enPassantSquare)))
+        {
+            int capturedSq { enPassantSquare - pushDirection };
+            U64 epBB { squareToBitboard(enPassantSquare) };
+            U64 capturedBB { squareToBitboard(capturedSq) };
+            if(checkMask & (epBB | capturedBB))
+            {
+                U64 occupancyAfter { (occupancy ^ fromBB ^ capturedBB) | epBB };
+                U64 rooksQueens { position.getPieceBitboard(makePiece(them, ROOK)) | position.getPieceBitboard(makePiece(them, QUEEN)) };
+                U64 bishopsQueens { position.getPieceBitboard(makePiece(them, BISHOP)) | position.getPieceBitboard(makePiece(them, QUEEN)) };
+                if(!(Attack::getRookAttacks(kingSq, occupancyAfter) & rooksQueens) && !(Attack::getBishopAttacks(kingSq, occupancyAfter) & bishopsQueens))
+                    moveList.add(encodeMove(from, enPassantSquare, EN_PASSANT_CAPTURE));
+            }
+        }
+    }
+}
+
+/*
+ * Generate castling moves. The king must not be in check (ensured by the caller),
+ * the squares between king and rook must be empty, and the squares the king
+ * passes over and lands on must not be attacked.
+ */
+void generateCastlingMoves(const Position& position, MoveList& moveList)
+{
+    const Side us { position.getSideToMove() };
+    const Side them { oppositeSide(us) };
+    const int castlingRights { position.getCastlingRights() };
+    const U64 occupancy { position.getPieceBitboard(ALL_PIECES) };
+    const U64 rooks { position.getPieceBitboard(makePiece(us, ROOK)) };
+
+    const int kingCastle { us == WHITE ? WHITE_KING_CASTLE : BLACK_KING_CASTLE };
+    const int queenCastle { us == WHITE ? WHITE_QUEEN_CASTLE : BLACK_QUEEN_CASTLE };
+    const int rankOffset { us == WHITE ? 0 : A8 };
+
+    if((castlingRights & kingCastle) && (rooks & squareToBitboard(H1 + rankOffset))
+        && !(occupancy & (squareToBitboard(F1 + rankOffset) | squareToBitboard(G1 + rankOffset)))
+        && !position.isSquareAttacked(F1 + rankOffset, them, occupancy)
+        && !position.isSquareAttacked(G1 + rankOffset, them, occupancy))
+    {
+        moveList.add(encodeMove(E1 + rankOffset, G1 + rankOffset, KING_CASTLE));
+    }
+
+    if((castlingRights & queenCastle) && (rooks & squareToBitboard(A1 + rankOffset))
+        && !(occupancy & (squareToBitboard(B1 + rankOffset) | squareToBitboard(C1 + rankOffset) | squareToBitboard(D1 + rankOffset)))
+        && !position.isSquareAttacked(D1 + rankOffset, them, occupancy)
+        && !position.isSquareAttacked(C1 + rankOffset, them, occupancy))
+    {
+        moveList.add(encodeMove(E1 + rankOffset, C1 + rankOffset, QUEEN_CASTLE));
+    }
+}
+
+/*
+ * Generate only strictly legal moves, so no make/test/unmake pass is needed afterwards.
+ * ALL_MOVES generates every legal move. NOISY_MOVES and QUIET_MOVES split them
+ * in two, by narrowing the target squares up front (to the enemy pieces or to
+ * the empty squares), so the moves of the other kind are never generated at all.
+ * Checkers and pinned pieces are computed once:
+ * - In double check only king moves are legal.
+ * - In single check every other piece must capture the checker or block the
+ *   ray between checker and king (checkMask).
+ * - A pinned piece may only move along the line through its king and pinner.
+ * King moves are tested with the king removed from the occupancy, so the king
+ * cannot step back along the ray of a slider that is checking it.
+ */
+template<GenType Type>
+void generateMoves(const Position& position, MoveList& moveList)
+{
+    moveList.count = 0;
+
+    const Side us { position.getSideToMove() };
+    const Side them { oppositeSide(us) };
+    const U64 ourPieces { position.getPieceBitboard(sideAllPieces(us)) };
+    const U64 enemyPieces { position.getPieceBitboard(sideAllPieces(them)) };
+    const U64 occupancy { position.getPieceBitboard(ALL_PIECES) };
+    const int kingSq { lsbIndex(position.getPieceBitboard(makePiece(us, KING))) };
+    const U64 kingBB { squareToBitboard(kingSq) };
+
+    const U64 enemyRooksQueens { position.getPieceBitboard(makePiece(them, ROOK)) | position.getPieceBitboard(makePiece(them, QUEEN)) };
+    const U64 enemyBishopsQueens { position.getPieceBitboard(makePiece(them, BISHOP)) | position.getPieceBitboard(makePiece(them, QUEEN)) };
+
+    const U64 checkers { (PAWN_ATTACKS[us][kingSq] & position.getPieceBitboard(makePiece(them, PAWN)))
+                       | (KNIGHT_ATTACKS[kingSq] & position.getPieceBitboard(makePiece(them, KNIGHT)))
+                       | (Attack::getRookAttacks(kingSq, occupancy) & enemyRooksQueens)
+                       | (Attack::getBishopAttacks(kingSq, occupancy) & enemyBishopsQueens) };
+
+    // 1. King moves
+    for(int to : squaresOf(KING_ATTACKS[kingSq] & targetSquares<Type>(ourPieces, enemyPieces)))
+    {
+        if(!position.isSquareAttacked(to, them, occupancy ^ kingBB))
+        {
+            int flag { (enemyPieces & squareToBitboard(to)) ? CAPTURE : QUIET_MOVE };
+            moveList.add(encodeMove(kingSq, to, flag));
+        }
+    }
+
+    // 2. Double check, only the king can move
+    if(moreThanOne(checkers))
+        return;
+
+    U64 checkMask { ~0ULL };
+    if(checkers)
+        checkMask = Attack::getBetween(kingSq, lsbIndex(checkers)) | checkers;
+    else if(Type != NOISY_MOVES)
+        generateCastlingMoves(position, moveList);
+
+    // 3. Pinned pieces, found from enemy sliders that see the king through exactly one of our pieces
+    U64 pinned { 0ULL };
+    const U64 snipers { (Attack::getRookAttacks(kingSq, enemyPieces) & enemyRooksQueens)
+                      | (Attack::getBishopAttacks(kingSq, enemyPieces) & enemyBishopsQueens) };
+    for(int sniperSq : squaresOf(snipers))
+    {
+        U64 blockers { Attack::getBetween(kingSq, sniperSq) & occupancy };
+        if(blockers && !moreThanOne(blockers) && (blockers & ourPieces))
+            pinned |= blockers;
+    }
+
+    // 4. Piece moves
+    const U64 targetMask { targetSquares<Type>(ourPieces, enemyPieces) & checkMask };
+
+    generatePawnMoves<Type>(position, moveList, kingSq, pinned, checkMask);
+
+    // A pinned knight can never move along its pin ray
+    for(int from : squaresOf(position.getPieceBitboard(makePiece(us, KNIGHT)) & ~pinned))
+    {
+        addPieceMoves(moveList, from, KNIGHT_ATTACKS[from] & targetMask, enemyPieces);
+    }
+
+    const U64 bishopsQueens { position.getPieceBitboard(makePiece(us, BISHOP)) | position.getPieceBitboard(makePiece(us, QUEEN)) };
+    for(int from : squaresOf(bishopsQueens))
+    {
+        U64 targets { Attack::getBishopAttacks(from, occupancy) & targetMask };
+        if(pinned & squareToBitboard(from))
+            targets &= Attack::getLine(kingSq, from);
+        addPieceMoves(moveList, from, targets, enemyPieces);
+    }
+
+    const U64 rooksQueens { position.getPieceBitboard(makePiece(us, ROOK)) | position.getPieceBitboard(makePiece(us, QUEEN)) };
+    for(int from : squaresOf(rooksQueens))
+    {
+        U64 targets { Attack::getRookAttacks(from, occupancy) & targetMask };
+        if(pinned & squareToBitboard(from))
+            targets &= Attack::getLine(kingSq, from);
+        addPieceMoves(moveList, from, targets, enemyPieces);
+    }
+}
+
+void MoveGen::generateLegalMoves(const Position& position, MoveList& moveList)
+{
+    generateMoves<ALL_MOVES>(position, moveList);
+}
+
+void MoveGen::generateNoisyMoves(const Position& position, MoveList& moveList)
+{
+    generateMoves<NOISY_MOVES>(position, moveList);
+}
+
+void MoveGen::generateQuietMoves(const Position& position, MoveList& moveList)
+{
+    generateMoves<QUIET_MOVES>(position, moveList);
+}
+
+/*
+ * Whether move is legal in position. Moves from the transposition table or the
+ * killer slots may come from a different position, so the move picker checks
+ * them with this before trying them, without generating any moves:
+ * first the piece, the flag and the target square are checked against the board
+ * (pseudo-legality), then the king must not be attacked after the move.
+ */
+bool MoveGen::isLegal(const Position& position, Move move)
+{
+    const int from { moveFrom(move) };
+    const int to { moveTo(move) };
+    const int flag { moveFlag(move) };
+    const Piece piece { position.pieceOn(from) };
+    const Side us { position.getSideToMove() };
+    const Side them { oppositeSide(us) };
+    // Flags between en passant and the promotions are unused
+    if(move == NO_MOVE || piece == EMPTY || sideOfPiece(piece) != us || (flag > EN_PASSANT_CAPTURE && flag < KNIGHT_PROMOTION))
+        return false;
+
+    const PieceType pieceType { typeOfPiece(piece) };
+    const U64 fromBB { squareToBitboard(from) };
+    const U64 toBB { squareToBitboard(to) };
+    const U64 ourPieces { position.getPieceBitboard(sideAllPieces(us)) };
+    const U64 enemyPieces { position.getPieceBitboard(sideAllPieces(them)) };
+    const U64 occupancy { position.getPieceBitboard(ALL_PIECES) };
+    const int pushDirection { us == WHITE ? NORTH : SOUTH };
+    if(ourPieces & toBB)
+        return false;
+
+    // Castling has its own conditions, reuse the generator for them
+    if(flag == KING_CASTLE || flag == QUEEN_CASTLE)
+    {
+        if(pieceType != KING || position.inCheck())
+            return false;
+        MoveList castlingMoves;
+        generateCastlingMoves(position, castlingMoves);
+        for(Move castlingMove : castlingMoves)
+            if(castlingMove == move)
+                return true;
+        return false;
+    }
+
+    // The capture flag has to match the target square
+    if(flag == EN_PASSANT_CAPTURE)
+    {
+        if(pieceType != PAWN || to != position.getEnPassantSquare() || !(PAWN_ATTACKS[us][from] & toBB))
+            return false;
+    }
+    else if(isCapture(move) != static_cast<bool>(enemyPieces & toBB))
+    {
+        return false;
+    }
+
+    if(pieceType == PAWN)
+    {
+        const U64 startRank { us == WHITE ? RANK_2_BB : RANK_7_BB };
+        const U64 promotionRank { us == WHITE ? RANK_8_BB : RANK_1_BB };
+        if(static_cast<bool>(promotionRank & toBB) != isPromotion(move))
+            return false;
+
+        if(isCapture(move))
+        {
+            if(!(PAWN_ATTACKS[us][from] & toBB))
+                return false;
+        }
+        else if(flag == DOUBLE_PAWN_PUSH)
+        {
+            if(!(startRank & fromBB) || to != from + 2 * pushDirection || (occupancy & (squareToBitboard(from + pushDirection) | toBB)))
+                return false;
+        }
+        else if(to != from + pushDirection || (occupancy & toBB))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        if(isPromotion(move) || flag == DOUBLE_PAWN_PUSH)
+            return false;
+
+        U64 attacks { 0ULL };
+        switch(pieceType)
+        {
+            case KNIGHT: attacks = KNIGHT_ATTACKS[from]; break;
+            case BISHOP: attacks = Attack::getBishopAttacks(from, occupancy); break;
+            case ROOK: attacks = Attack::getRookAttacks(from, occupancy); break;
+            case QUEEN: attacks = Attack::getQueenAttacks(from, occupancy); break;
+            default: attacks = KING_ATTACKS[from]; break;
+        }
+        if(!(attacks & toBB))
+            return false;
+    }
+
+    // The king must not be attacked afterwards, by any enemy piece other than the captured one
+    const U64 capturedBB { flag == EN_PASSANT_CAPTURE ? squareToBitboard(to - pushDirection) : toBB };
+    const U64 occupancyAfter { (occupancy ^ fromBB ^ (flag == EN_PASSANT_CAPTURE ? capturedBB : 0ULL)) | toBB };
+    const int kingSq { pieceType == KING ? to : lsbIndex(position.getPieceBitboard(makePiece(us, KING))) };
+    return !(position.attackersTo(kingSq, occupancyAfter) & enemyPieces & ~capturedBB);
+}
@@ -0,0 +1,25 @@
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+#include "move.h" // Move, MoveList
+#include "position.h" // Position
+
+/*
+ * ALL_MOVES: every legal move.
+ * NOISY_MOVES: legal captures (en passant included) and queen promotions.
+ * QUIET_MOVES: the rest, non-captures and underpromotions.
+ */
+enum GenType : int
+{
+    ALL_MOVES, NOISY_MOVES, QUIET_MOVES
+};
+
+namespace MoveGen
+{
+    void generateLegalMoves(const Position& position, MoveList& moveList);
+    void generateNoisyMoves(const Position& position, MoveList& moveList);
+    void generateQuietMoves(const Position& position, MoveList& moveList);
+    bool isLegal(const Position& position, Move move);
+}
+
+#endif
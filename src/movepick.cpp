@@ -0,0 +1,152 @@
+#include "eval.h" // PIECE_VALUES
+#include "move.h" // Move, NO_MOVE, moveFrom(), moveTo(), moveFlag(), isCapture(), isPromotion()
+#include "movegen.h" // MoveGen::generateNoisyMoves(), MoveGen::generateQuietMoves(), MoveGen::isLegal()
+#include "movepick.h"
+#include "position.h" // Position
+#include "types.h" // PieceType, PAWN, QUEEN, typeOfPiece()
+
+#include <utility> // std::swap()
+
+MovePicker::MovePicker(const Position& position, const HistoryTable& history, Move ttMove, Move firstKiller, Move secondKiller)
+    : position { position }, history { history }, ttMove { ttMove }, killers { firstKiller, secondKiller },
+      noisyOnly { false }, stage { PICK_TT_MOVE }, moveList {}
+{
+}
+
+MovePicker::MovePicker(const Position& position, const HistoryTable& history)
+    : position { position }, history { history }, ttMove { NO_MOVE }, killers { NO_MOVE, NO_MOVE },
+      noisyOnly { !position.inCheck() }, stage { PICK_GENERATE_CAPTURES }, moveList {}
+{
+}
+
+/*
+ * Most valuable victim / least valuable attacker, with the gain of a
+ * queen promotion counted like a captured piece.
+ */
+void MovePicker::scoreCaptures()
+{
+    for(int i { 0 }; i < this->moveList.size(); ++i)
+    {
+        const Move move { this->moveList.moves[i] };
+        const PieceType victim { moveFlag(move) == EN_PASSANT_CAPTURE ? PAWN : typeOfPiece(this->position.pieceOn(moveTo(move))) };
+        const PieceType attacker { typeOfPiece(this->position.pieceOn(moveFrom(move))) };
+        const int promotionGain { isPromotion(move) ? PIECE_VALUES[QUEEN] - PIECE_VALUES[PAWN] : 0 };
+        this->moveScores[i] = (PIECE_VALUES[victim] + promotionGain) * 10 - attacker;
+    }
+}
+
+void MovePicker::scoreQuiets()
+{
+    for(int i { 0 }; i < this->moveList.size(); ++i)
+    {
+        const Move move { this->moveList.moves[i] };
+        this->moveScores[i] = this->history[moveFrom(move)][moveTo(move)];
+    }
+}
+
+/*
+ * Selection sort step: bring the best scored move of the rest of the list
+ * to the current index and return it. Only the moves actually picked get sorted.
+ */
+Move MovePicker::selectBest()
+{
+    int best { this->current };
+    for(int i { this->current + 1 }; i < this->moveList.size(); ++i)
+    {
+        if(this->moveScores[i] > this->moveScores[best])
+            best = i;
+    }
+    std::swap(this->moveScores[this->current], this->moveScores[best]);
+    std::swap(this->moveList.moves[this->current], this->moveList.moves[best]);
+    return this->moveList.moves[this->current++];
+}
+
+/*
+ * Killers come from sibling nodes, so they have to be legal and still quiet here.
+ */
+bool MovePicker::isUsableKiller(Move killer) const
+{
+    return killer != this->ttMove && !isCapture(killer) && MoveGen::isLegal(this->position, killer);
+}
+
+/*
+ * Return the next move to search, or NO_MOVE once all moves have been returned.
+ */
+Move MovePicker::nextMove()
+{
+    switch(this->stage)
+    {
+        case PICK_TT_MOVE:
+            ++this->stage;
+            if(MoveGen::isLegal(this->position, this->ttMove))
+                return this->ttMove;
+            [[fallthrough]];
+
+        case PICK_GENERATE_CAPTURES:
+            MoveGen::generateNoisyMoves(this->position, this->moveList);
+            this->scoreCaptures();
+            this->current = 0;
+            ++this->stage;
+            [[fallthrough]];
+
+        case PICK_GOOD_CAPTURES:
+            while(this->current < this->moveList.size())
+            {
+                const Move move { this->selectBest() };
+                if(move == this->ttMove)
+                    continue;
+                if(this->position.staticExchangeEvaluation(move) < 0)
+                {
+                    this->badCaptures[this->badCaptureCount++] = move;
+                    continue;
+                }
+                return move;
+            }
+            if(this->noisyOnly)
+            {
+                this->stage = PICK_DONE;
+                return NO_MOVE;
+            }
+            ++this->stage;
+            [[fallthrough]];
+
+        case PICK_FIRST_KILLER:
+            ++this->stage;
+            if(this->isUsableKiller(this->killers[0]))
+                return this->killers[0];
+            [[fallthrough]];
+
+        case PICK_SECOND_KILLER:
+            ++this->stage;
+            if(this->killers[1] != this->killers[0] && this->isUsableKiller(this->killers[1]))
+                return this->killers[1];
+            [[fallthrough]];
+
+        case PICK_GENERATE_QUIETS:
+            MoveGen::generateQuietMoves(this->position, this->moveList);
+            this->scoreQuiets();
+            this->current = 0;
+            ++this->stage;
+            [[fallthrough]];
+
+        case PICK_QUIETS:
+            while(this->current < this->moveList.size())
+            {
+                const Move move { this->selectBest() };
+                if(move != this->ttMove && move != this->killers[0] && move != this->killers[1])
+                    return move;
+            }
+            this->current = 0;
+            ++this->stage;
+            [[fallthrough]];
+
+        case PICK_BAD_CAPTURES:
+            if(this->current < this->badCaptureCount)
+                return this->badCaptures[this->current++];
+            ++this->stage;
+            [[fallthrough]];
+
+        default:
+            return NO_MOVE;
+    }
+}
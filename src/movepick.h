@@ -0,0 +1,60 @@
+#ifndef MOVEPICK_H
+#define MOVEPICK_H
+
+#include "move.h" // Move, MoveList, MAX_MOVES
+#include "position.h" // Position
+#include "types.h" // NUM_SQUARES
+
+/*
+ * Butterfly history of one side, indexed by [from][to].
+ */
+using HistoryTable = int[NUM_SQUARES][NUM_SQUARES];
+
+/*
+ * Stages of the move picker, in the order they are tried.
+ */
+enum PickStage : int
+{
+    PICK_TT_MOVE, PICK_GENERATE_CAPTURES, PICK_GOOD_CAPTURES, PICK_FIRST_KILLER, PICK_SECOND_KILLER,
+    PICK_GENERATE_QUIETS, PICK_QUIETS, PICK_BAD_CAPTURES, PICK_DONE
+};
+
+/*
+ * Hands out the moves of a node one at a time, best first, generating them
+ * in stages so a node that cuts off early never generates the rest:
+ * 1. the transposition table move, checked for legality instead of generated,
+ * 2. captures and queen promotions by MVV-LVA, those losing material by
+ *    static exchange evaluation are put aside for the end,
+ * 3. the two killer moves of the ply,
+ * 4. the remaining quiet moves by their history score,
+ * 5. the losing captures.
+ * Each stage is ordered lazily by a selection sort step per move picked.
+ * The quiescence search picker only returns the winning and equal captures,
+ * unless the side to move is in check, when it returns every move.
+ */
+class MovePicker
+{
+    private:
+        const Position& position;
+        const HistoryTable& history;
+        const Move ttMove;
+        const Move killers[2];
+        const bool noisyOnly;
+        int stage;
+        int current { 0 };
+        int badCaptureCount { 0 };
+        MoveList moveList;
+        int moveScores[MAX_MOVES];
+        Move badCaptures[MAX_MOVES];
+
+        void scoreCaptures();
+        void scoreQuiets();
+        Move selectBest();
+        bool isUsableKiller(Move killer) const;
+    public:
+        MovePicker(const Position& position, const HistoryTable& history, Move ttMove, Move firstKiller, Move secondKiller);
+        MovePicker(const Position& position, const HistoryTable& history);
+        Move nextMove();
+};
+
+#endif
@@ -0,0 +1,262 @@
+#include "nnue.h"
+#include "mappedfile.h" // MappedFile
+#include "search.h" // TB_WIN_IN_MAX_PLY
+#include "types.h" // Piece, Side, WHITE, WHITE_KING, NUM_SIDES, NUM_SQUARES
+
+#include <algorithm> // std::clamp()
+#include <cstddef> // std::size_t
+#include <cstdlib> // std::abs()
+#include <cstdint> // std::int16_t, std::int32_t
+#include <cstring> // std::memcpy()
+#include <string> // std::string
+#include <string_view> // std::string_view
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h> // AVX2 and SSE2 intrinsics
+#endif
+
+/*
+ * Quantisation of the network, as trained with the bullet trainer's simple format:
+ * hidden layer weights are scaled by QA, output weights by QB, and the output
+ * is scaled to centipawns by EVAL_SCALE.
+ */
+constexpr int QA { 255 };
+constexpr int QB { 64 };
+constexpr int EVAL_SCALE { 400 };
+
+// Largest output weight the SIMD output layer handles without overflow, see screluDot()
+constexpr int MAX_OUTPUT_WEIGHT { 127 };
+
+/*
+ * The network file is read in place from the memory mapped file, as little endian int16:
+ *
+ * featureWeights  [NNUE_INPUTS][NNUE_HIDDEN]
+ * featureBiases   [NNUE_HIDDEN]
+ * outputWeights   [2 * NNUE_HIDDEN]
+ * outputBias      [1]
+ *
+ * Trainers pad the file to a multiple of 64 bytes, the padding is ignored.
+ */
+constexpr std::size_t NETWORK_VALUES { NNUE_INPUTS * NNUE_HIDDEN + NNUE_HIDDEN + 2 * NNUE_HIDDEN + 1 };
+constexpr std::size_t NETWORK_BYTES { NETWORK_VALUES * sizeof(std::int16_t) };
+
+struct Network
+{
+    const std::int16_t* featureWeights { nullptr };
+    const std::int16_t* featureBiases { nullptr };
+    const std::int16_t* outputWeights { nullptr };
+    std::int16_t outputBias {};
+};
+
+MappedFile networkFile {};
+Network network {};
+
+/*
+ * Input index of a piece on a square, from one side's perspective. White sees
+ * the board as it is, index (piece - 1) * 64 + sq following the Piece enum and
+ * LERFSquare. Black sees it with colours swapped and ranks mirrored, so both
+ * perspectives share one set of weights.
+ */
+constexpr int featureIndex(Side perspective, Piece piece, int sq)
+{
+    if(perspective == WHITE)
+        return (piece - 1) * NUM_SQUARES + sq;
+    const int flippedPiece { piece > WHITE_KING ? piece - static_cast<int>(WHITE_KING) : piece + static_cast<int>(WHITE_KING) };
+    return (flippedPiece - 1) * NUM_SQUARES + (sq ^ 56);
+}
+
+const std::int16_t* featureWeights(Side perspective, Piece piece, int sq)
+{
+    return network.featureWeights + static_cast<std::size_t>(featureIndex(perspective, piece, sq)) * NNUE_HIDDEN;
+}
+
+/*
+ * SIMD kernels. AVX2 handles 16 int16 lanes at once, SSE2 (present on every x86-64 CPU) 8,
+ * and other targets fall back to plain loops, which compilers vectorise where they can.
+ */
+#if defined(__AVX2__)
+using Vector = __m256i;
+constexpr int VECTOR_LANES { 16 };
+inline Vector vectorLoad(const std::int16_t* values) { return _mm256_loadu_si256(reinterpret_cast<const Vector*>(values)); }
+inline void vectorStore(std::int16_t* values, Vector vector) { _mm256_storeu_si256(reinterpret_cast<Vector*>(values), vector); }
+inline Vector vectorAdd(Vector a, Vector b) { return _mm256_add_epi16(a, b); }
+inline Vector vectorSub(Vector a, Vector b) { return _mm256_sub_epi16(a, b); }
+inline Vector vectorClamp(Vector vector) { return _mm256_min_epi16(_mm256_max_epi16(vector, _mm256_setzero_si256()), _mm256_set1_epi16(QA)); }
+inline Vector vectorMultiply(Vector a, Vector b) { return _mm256_mullo_epi16(a, b); }
+inline Vector vectorMultiplyAdd(Vector a, Vector b) { return _mm256_madd_epi16(a, b); }
+inline Vector vectorAdd32(Vector a, Vector b) { return _mm256_add_epi32(a, b); }
+inline Vector vectorZero() { return _mm256_setzero_si256(); }
+inline int vectorSum32(Vector vector)
+{
+    __m128i sum { _mm_add_epi32(_mm256_castsi256_si128(vector), _mm256_extracti128_si256(vector, 1)) };
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+#elif defined(__SSE2__)
+using Vector = __m128i;
+constexpr int VECTOR_LANES { 8 };
+inline Vector vectorLoad(const std::int16_t* values) { return _mm_loadu_si128(reinterpret_cast<const Vector*>(values)); }
+inline void vectorStore(std::int16_t* values, Vector vector) { _mm_storeu_si128(reinterpret_cast<Vector*>(values), vector); }
+inline Vector vectorAdd(Vector a, Vector b) { return _mm_add_epi16(a, b); }
+inline Vector vectorSub(Vector a, Vector b) { return _mm_sub_epi16(a, b); }
+inline Vector vectorClamp(Vector vector) { return _mm_min_epi16(_mm_max_epi16(vector, _mm_setzero_si128()), _mm_set1_epi16(QA)); }
+inline Vector vectorMultiply(Vector a, Vector b) { return _mm_mullo_epi16(a, b); }
+inline Vector vectorMultiplyAdd(Vector a, Vector b) { return _mm_madd_epi16(a, b); }
+inline Vector vectorAdd32(Vector a, Vector b) { return _mm_add_epi32(a, b); }
+inline Vector vectorZero() { return _mm_setzero_si128(); }
+inline int vectorSum32(Vector vector)
+{
+    vector = _mm_add_epi32(vector, _mm_shuffle_epi32(vector, 0x4E));
+    vector = _mm_add_epi32(vector, _mm_shuffle_epi32(vector, 0xB1));
+    return _mm_cvtsi128_si32(vector);
+}
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+static_assert(NNUE_HIDDEN % VECTOR_LANES == 0, "Hidden layer size must be a multiple of the vector width");
+#endif
+
+/*
+ * values += add - sub over one accumulator half. Either weight row may be null.
+ */
+void updateHalf(std::int16_t* values, const std::int16_t* add, const std::int16_t* sub)
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+    for(int i { 0 }; i < NNUE_HIDDEN; i += VECTOR_LANES)
+    {
+        Vector vector { vectorLoad(values + i) };
+        if(add)
+            vector = vectorAdd(vector, vectorLoad(add + i));
+        if(sub)
+            vector = vectorSub(vector, vectorLoad(sub + i));
+        vectorStore(values + i, vector);
+    }
+#else
+    for(int i { 0 }; i < NNUE_HIDDEN; ++i)
+        values[i] = static_cast<std::int16_t>(values[i] + (add ? add[i] : 0) - (sub ? sub[i] : 0));
+#endif
+}
+
+/*
+ * Squared clipped ReLU of one accumulator half dotted with its output weights.
+ * The SIMD path computes (v * w) * v as madd(mullo(v, w), v), which needs
+ * |v * w| < 32768, true for v <= QA and the |w| <= 127 the trainer clips to,
+ * which load() checks.
+ */
+int screluDot(const std::int16_t* values, const std::int16_t* weights)
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+    Vector sum { vectorZero() };
+    for(int i { 0 }; i < NNUE_HIDDEN; i += VECTOR_LANES)
+    {
+        const Vector clamped { vectorClamp(vectorLoad(values + i)) };
+        sum = vectorAdd32(sum, vectorMultiplyAdd(vectorMultiply(clamped, vectorLoad(weights + i)), clamped));
+    }
+    return vectorSum32(sum);
+#else
+    int sum { 0 };
+    for(int i { 0 }; i < NNUE_HIDDEN; ++i)
+    {
+        const int clamped { std::clamp(static_cast<int>(values[i]), 0, QA) };
+        sum += clamped * clamped * weights[i];
+    }
+    return sum;
+#endif
+}
+
+/*
+ * Load a network file. The file is memory mapped and read in place.
+ * Returns false, keeping no network loaded, if the file cannot be mapped,
+ * its size does not match the network shape, or an output weight is out of
+ * the range the SIMD output layer computes exactly.
+ */
+bool NNUE::load(const std::string& fileName)
+{
+    NNUE::unload();
+    if(!networkFile.open(fileName))
+        return false;
+
+    const std::string_view data { networkFile.view() };
+    if(data.size() < NETWORK_BYTES || data.size() >= NETWORK_BYTES + 64)
+    {
+        networkFile.close();
+        return false;
+    }
+
+    const std::int16_t* values { reinterpret_cast<const std::int16_t*>(data.data()) };
+    network.featureWeights = values;
+    network.featureBiases = network.featureWeights + NNUE_INPUTS * NNUE_HIDDEN;
+    network.outputWeights = network.featureBiases + NNUE_HIDDEN;
+    for(int i { 0 }; i < 2 * NNUE_HIDDEN; ++i)
+    {
+        if(std::abs(static_cast<int>(network.outputWeights[i])) > MAX_OUTPUT_WEIGHT)
+        {
+            NNUE::unload();
+            return false;
+        }
+    }
+    std::memcpy(&network.outputBias, network.outputWeights + 2 * NNUE_HIDDEN, sizeof(std::int16_t));
+    networkLoaded = true;
+    return true;
+}
+
+void NNUE::unload()
+{
+    networkLoaded = false;
+    network = Network {};
+    networkFile.close();
+}
+
+/*
+ * Recompute both accumulator halves from the board, the biases plus
+ * the weight row of every piece on it.
+ */
+void NNUE::refresh(Accumulator& accumulator, const Piece (&board)[NUM_SQUARES])
+{
+    for(int side { WHITE }; side < NUM_SIDES; ++side)
+    {
+        std::int16_t* values { accumulator.values[side] };
+        std::memcpy(values, network.featureBiases, sizeof(accumulator.values[side]));
+        for(int sq { A1 }; sq < NUM_SQUARES; ++sq)
+        {
+            if(board[sq] != EMPTY)
+                updateHalf(values, featureWeights(static_cast<Side>(side), board[sq], sq), nullptr);
+        }
+    }
+}
+
+/*
+ * Incremental updates, one weight row per changed input and perspective.
+ */
+void NNUE::addPiece(Accumulator& accumulator, Piece piece, int sq)
+{
+    updateHalf(accumulator.values[WHITE], featureWeights(WHITE, piece, sq), nullptr);
+    updateHalf(accumulator.values[BLACK], featureWeights(BLACK, piece, sq), nullptr);
+}
+
+void NNUE::removePiece(Accumulator& accumulator, Piece piece, int sq)
+{
+    updateHalf(accumulator.values[WHITE], nullptr, featureWeights(WHITE, piece, sq));
+    updateHalf(accumulator.values[BLACK], nullptr, featureWeights(BLACK, piece, sq));
+}
+
+void NNUE::movePiece(Accumulator& accumulator, Piece piece, int from, int to)
+{
+    updateHalf(accumulator.values[WHITE], featureWeights(WHITE, piece, to), featureWeights(WHITE, piece, from));
+    updateHalf(accumulator.values[BLACK], featureWeights(BLACK, piece, to), featureWeights(BLACK, piece, from));
+}
+
+/*
+ * Evaluate in centipawns from the point of view of the side to move.
+ * The result is clamped below the tablebase and mate scores, so no
+ * evaluation is ever mistaken for one.
+ */
+int NNUE::evaluate(const Accumulator& accumulator, Side sideToMove)
+{
+    long long output { static_cast<long long>(screluDot(accumulator.values[sideToMove], network.outputWeights))
+                     + screluDot(accumulator.values[oppositeSide(sideToMove)], network.outputWeights + NNUE_HIDDEN) };
+    output = output / QA + network.outputBias;
+    output = output * EVAL_SCALE / (QA * QB);
+    return static_cast<int>(std::clamp<long long>(output, -TB_WIN_IN_MAX_PLY + 1, TB_WIN_IN_MAX_PLY - 1));
+}
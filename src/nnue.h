@@ -0,0 +1,42 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "types.h" // Piece, Side, NUM_SIDES, NUM_SQUARES
+
+#include <cstdint> // std::int16_t
+#include <string> // std::string
+
+/*
+ * Network shape: 768 inputs, one per (piece, square), feed a hidden layer of
+ * NNUE_HIDDEN neurons, once from each side's perspective. The two halves are
+ * concatenated, side to move first, and feed a single output neuron.
+ */
+inline constexpr int NNUE_INPUTS { 768 };
+inline constexpr int NNUE_HIDDEN { 256 };
+
+/*
+ * Hidden layer pre-activations, one half per perspective.
+ * Kept in Position and updated incrementally as pieces move.
+ */
+struct alignas(64) Accumulator
+{
+    std::int16_t values[NUM_SIDES][NNUE_HIDDEN];
+};
+
+namespace NNUE
+{
+    // Set while a network is loaded, only changed when no search is running
+    inline bool networkLoaded { false };
+
+    bool load(const std::string& fileName);
+    void unload();
+    inline bool isLoaded() { return networkLoaded; }
+
+    void refresh(Accumulator& accumulator, const Piece (&board)[NUM_SQUARES]);
+    void addPiece(Accumulator& accumulator, Piece piece, int sq);
+    void removePiece(Accumulator& accumulator, Piece piece, int sq);
+    void movePiece(Accumulator& accumulator, Piece piece, int from, int to);
+    int evaluate(const Accumulator& accumulator, Side sideToMove);
+}
+
+#endif
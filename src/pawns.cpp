@@ -0,0 +1,152 @@
+#include "pawns.h"
+#include "bitboard.h" // popcount(), lsbIndex(), shift(), northFill(), southFill(), fileFill(), squaresOf()
+#include "position.h" // Position
+#include "types.h" // U64, Side, WHITE_PAWN, BLACK_PAWN, NUM_RANKS, NUM_FILES, NO_SQ, makePiece()
+
+#include <algorithm> // std::fill()
+#include <cstddef> // std::size_t
+#include <memory> // std::make_unique()
+
+/*
+ * Pawn structure terms as {midgame, endgame}, in centipawns.
+ */
+constexpr int DOUBLED_PAWN[2] { -10, -25 };
+constexpr int ISOLATED_PAWN[2] { -5, -15 };
+constexpr int BACKWARD_PAWN[2] { -9, -20 };
+
+// Passed pawn bonus by rank, relative to the side owning the pawn
+constexpr int PASSED_PAWN_MIDGAME[NUM_RANKS] { 0, 0, 5, 10, 20, 35, 60, 0 };
+constexpr int PASSED_PAWN_ENDGAME[NUM_RANKS] { 0, 10, 15, 25, 45, 75, 120, 0 };
+
+// Middlegame bonus per own pawn directly in front of the king and one rank further
+constexpr int SHELTER_NEAR { 12 };
+constexpr int SHELTER_FAR { 6 };
+
+/*
+ * Squares in front of the pawns, towards promotion, excluding the pawns themselves.
+ */
+template<Side Us>
+constexpr U64 frontSpans(U64 pawns)
+{
+    return Us == WHITE ? northFill(shift<NORTH>(pawns)) : southFill(shift<SOUTH>(pawns));
+}
+
+template<Side Us>
+constexpr U64 pawnAttacksOf(U64 pawns)
+{
+    return Us == WHITE ? shift<NORTH_EAST>(pawns) | shift<NORTH_WEST>(pawns) : shift<SOUTH_EAST>(pawns) | shift<SOUTH_WEST>(pawns);
+}
+
+constexpr U64 adjacentFiles(U64 bitboard)
+{
+    return shift<EAST>(bitboard) | shift<WEST>(bitboard);
+}
+
+/*
+ * Evaluate the pawns of one side, and fill in its passed pawns and attack bitboards.
+ * Scores are added from the point of view of Us.
+ * Credit for the definitions: https://www.chessprogramming.org/Pawn_Structure
+ */
+template<Side Us>
+void evaluatePawns(PawnEntry& entry, U64 ourPawns, U64 theirPawns, int& midgame, int& endgame)
+{
+    constexpr Side Them { Us == WHITE ? BLACK : WHITE };
+
+    entry.pawnAttacks[Us] = pawnAttacksOf<Us>(ourPawns);
+    entry.pawnAttackSpans[Us] = adjacentFiles(frontSpans<Us>(ourPawns));
+
+    // Doubled, every pawn with an own pawn in front of it
+    const int doubled { popcount(ourPawns & frontSpans<Them>(ourPawns)) };
+
+    // Isolated, no own pawns on the adjacent files
+    const U64 isolated { ourPawns & ~adjacentFiles(fileFill(ourPawns)) };
+
+    // Backward, no own pawn beside or behind it on the adjacent files,
+    // and the square in front is controlled by an enemy pawn
+    const U64 supportable { adjacentFiles(frontSpans<Us>(ourPawns) | ourPawns) };
+    const U64 stopSquaresAttacked { Us == WHITE ? shift<SOUTH>(pawnAttacksOf<Them>(theirPawns)) : shift<NORTH>(pawnAttacksOf<Them>(theirPawns)) };
+    const U64 backward { ourPawns & ~supportable & stopSquaresAttacked & ~isolated };
+
+    // Passed, no enemy pawns in front on the same or adjacent files
+    const U64 theirFronts { frontSpans<Them>(theirPawns) };
+    entry.passedPawns[Us] = ourPawns & ~(theirFronts | adjacentFiles(theirFronts));
+
+    midgame += doubled * DOUBLED_PAWN[0] + popcount(isolated) * ISOLATED_PAWN[0] + popcount(backward) * BACKWARD_PAWN[0];
+    endgame += doubled * DOUBLED_PAWN[1] + popcount(isolated) * ISOLATED_PAWN[1] + popcount(backward) * BACKWARD_PAWN[1];
+    for(int sq : squaresOf(entry.passedPawns[Us]))
+    {
+        const int relativeRank { Us == WHITE ? sq / NUM_FILES : 7 - sq / NUM_FILES };
+        midgame += PASSED_PAWN_MIDGAME[relativeRank];
+        endgame += PASSED_PAWN_ENDGAME[relativeRank];
+    }
+}
+
+/*
+ * Return the entry for the pawn configuration of position, evaluating it on a miss.
+ * Entries are always replaced, the table only needs to remember recent structures.
+ */
+PawnEntry& PawnTable::probe(const Position& position)
+{
+    const U64 key { position.getPawnKey() };
+    PawnEntry& entry = this->entries[static_cast<std::size_t>(key) & (PAWN_TABLE_SIZE - 1)];
+    if(entry.key == key)
+        return entry;
+
+    const U64 whitePawns { position.getPieceBitboard(WHITE_PAWN) };
+    const U64 blackPawns { position.getPieceBitboard(BLACK_PAWN) };
+    int whiteMidgame { 0 };
+    int whiteEndgame { 0 };
+    int blackMidgame { 0 };
+    int blackEndgame { 0 };
+    evaluatePawns<WHITE>(entry, whitePawns, blackPawns, whiteMidgame, whiteEndgame);
+    evaluatePawns<BLACK>(entry, blackPawns, whitePawns, blackMidgame, blackEndgame);
+
+    entry.key = key;
+    entry.midgameScore = whiteMidgame - blackMidgame;
+    entry.endgameScore = whiteEndgame - blackEndgame;
+    entry.kingSquares[WHITE] = NO_SQ;
+    entry.kingSquares[BLACK] = NO_SQ;
+    return entry;
+}
+
+void PawnTable::clear()
+{
+    std::fill(this->entries.get(), this->entries.get() + PAWN_TABLE_SIZE, PawnEntry {});
+}
+
+/*
+ * Make sure there is a table for each of numThreads threads. Existing tables are kept.
+ */
+void PawnTablePool::reserve(int numThreads)
+{
+    while(this->tables.size() < static_cast<std::size_t>(numThreads))
+        this->tables.push_back(std::make_unique<PawnTable>());
+}
+
+void PawnTablePool::clear()
+{
+    for(const std::unique_ptr<PawnTable>& table : this->tables)
+        table->clear();
+}
+
+/*
+ * Middlegame pawn shelter of the king of side, from the point of view of side:
+ * own pawns on the king's file and the adjacent files, one and two ranks in front.
+ * Cached in the entry until the king moves.
+ */
+int Pawns::kingShelter(PawnEntry& entry, const Position& position, Side side)
+{
+    const U64 king { position.getPieceBitboard(makePiece(side, KING)) };
+    const int kingSq { lsbIndex(king) };
+    if(entry.kingSquares[side] == kingSq)
+        return entry.kingShelters[side];
+
+    const U64 pawns { position.getPieceBitboard(makePiece(side, PAWN)) };
+    const U64 files { king | adjacentFiles(king) };
+    const U64 near { side == WHITE ? shift<NORTH>(files) : shift<SOUTH>(files) };
+    const U64 far { side == WHITE ? shift<NORTH>(near) : shift<SOUTH>(near) };
+
+    entry.kingSquares[side] = kingSq;
+    entry.kingShelters[side] = popcount(pawns & near) * SHELTER_NEAR + popcount(pawns & far) * SHELTER_FAR;
+    return entry.kingShelters[side];
+}
@@ -0,0 +1,65 @@
+#ifndef PAWNS_H
+#define PAWNS_H
+
+#include "position.h" // Position
+#include "types.h" // U64, NUM_SIDES, LERFSquare
+
+#include <cstddef> // std::size_t
+#include <memory> // std::unique_ptr
+#include <vector> // std::vector
+
+/*
+ * Cached pawn structure evaluation of one pawn configuration. Scores are
+ * from white's point of view. The king shelter depends on the king square too,
+ * so it is cached per side together with the king square it was computed for.
+ */
+struct PawnEntry
+{
+    U64 key {};
+    int midgameScore {};
+    int endgameScore {};
+    U64 passedPawns[NUM_SIDES] {};
+    U64 pawnAttacks[NUM_SIDES] {};
+    U64 pawnAttackSpans[NUM_SIDES] {}; // Squares the pawns attack now or after advancing
+    int kingSquares[NUM_SIDES] { NO_SQ, NO_SQ };
+    int kingShelters[NUM_SIDES] {};
+};
+
+/*
+ * Pawn hash table, indexed by the pawn key. Each search thread owns one, so
+ * there is no locking. Pawns move rarely, so most probes in a search hit.
+ */
+inline constexpr std::size_t PAWN_TABLE_SIZE { 8192 };
+
+class PawnTable
+{
+    private:
+        std::unique_ptr<PawnEntry[]> entries { std::make_unique<PawnEntry[]>(PAWN_TABLE_SIZE) };
+    public:
+        PawnEntry& probe(const Position& position);
+        void clear();
+};
+
+/*
+ * One pawn table per search thread, kept from search to search like the
+ * transposition table, so the tables stay warm across the moves of a game.
+ * Grown with reserve() before the threads start, which then each use their own table.
+ */
+class PawnTablePool
+{
+    private:
+        std::vector<std::unique_ptr<PawnTable>> tables {};
+    public:
+        void reserve(int numThreads);
+        void clear();
+        PawnTable& forThread(int threadId) { return *this->tables[static_cast<std::size_t>(threadId)]; }
+};
+
+inline PawnTablePool PAWN_TABLES {};
+
+namespace Pawns
+{
+    int kingShelter(PawnEntry& entry, const Position& position, Side side);
+}
+
+#endif
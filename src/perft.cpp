@@ -0,0 +1,173 @@
+#include "move.h" // Move, MoveList, moveToString()
+#include "movegen.h" // MoveGen::generateLegalMoves()
+#include "perft.h"
+#include "position.h" // Position
+#include "types.h" // U64
+#include "uci.h" // uciOutput()
+
+#include <algorithm> // std::min(), std::max()
+#include <atomic> // std::atomic
+#include <chrono> // std::chrono::steady_clock, std::chrono::duration_cast
+#include <cstddef> // std::size_t
+#include <memory> // std::unique_ptr
+#include <string> // std::to_string()
+#include <thread> // std::thread
+#include <vector> // std::vector
+
+/*
+ * Perft hash entry, shared between all perft threads without locks.
+ * The data word packs the node count (upper 56 bits) and depth (lower 8 bits),
+ * and is stored a second time XORed with the position key. A torn write from
+ * two threads racing on the same entry fails the XOR check and reads as a miss.
+ * Credit: Robert Hyatt and Tim Mann, "A lockless transposition-table implementation
+ * for parallel search", ICGA Journal 25(1), 2002.
+ */
+struct PerftEntry
+{
+    std::atomic<U64> keyXorData {};
+    std::atomic<U64> data {};
+};
+
+class PerftTable
+{
+    private:
+        std::unique_ptr<PerftEntry[]> entries {};
+        U64 indexMask {};
+        U64 index(U64 key, int depth) const { return (key ^ (static_cast<U64>(depth) * 0x9E3779B97F4A7C15ULL)) & this->indexMask; }
+    public:
+        explicit PerftTable(int megabytes);
+        bool probe(U64 key, int depth, U64& nodes) const;
+        void store(U64 key, int depth, U64 nodes);
+};
+
+/*
+ * Allocate the largest power of two number of entries fitting in megabytes.
+ * A size of 0 disables the table.
+ */
+PerftTable::PerftTable(int megabytes)
+{
+    if(megabytes <= 0)
+        return;
+
+    std::size_t numEntries { 1 };
+    while(numEntries * 2 * sizeof(PerftEntry) <= static_cast<std::size_t>(megabytes) * 1024 * 1024)
+        numEntries *= 2;
+
+    this->entries = std::make_unique<PerftEntry[]>(numEntries);
+    this->indexMask = numEntries - 1;
+}
+
+bool PerftTable::probe(U64 key, int depth, U64& nodes) const
+{
+    if(!this->entries)
+        return false;
+
+    const PerftEntry& entry = this->entries[this->index(key, depth)];
+    U64 data { entry.data.load(std::memory_order_relaxed) };
+    U64 keyXorData { entry.keyXorData.load(std::memory_order_relaxed) };
+    if((keyXorData ^ data) != key || static_cast<int>(data & 0xFF) != depth)
+        return false;
+
+    nodes = data >> 8;
+    return true;
+}
+
+void PerftTable::store(U64 key, int depth, U64 nodes)
+{
+    if(!this->entries)
+        return;
+
+    PerftEntry& entry = this->entries[this->index(key, depth)];
+    U64 data { (nodes << 8) | static_cast<U64>(depth) };
+    entry.keyXorData.store(key ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+}
+
+/*
+ * Count leaf nodes of the legal move tree to the given depth.
+ * Bulk counting: at depth 1 the number of legal moves is returned
+ * directly, without making any of them.
+ */
+U64 perftRecursive(Position& position, int depth, PerftTable& table)
+{
+    if(depth == 0)
+        return 1ULL;
+
+    U64 nodes { 0ULL };
+    const U64 key { position.getPositionIdentity() };
+    if(depth > 1 && table.probe(key, depth, nodes))
+        return nodes;
+
+    MoveList moveList;
+    MoveGen::generateLegalMoves(position, moveList);
+    if(depth == 1)
+        return static_cast<U64>(moveList.size());
+
+    for(Move move : moveList)
+    {
+        position.makeMove(move);
+        nodes += perftRecursive(position, depth - 1, table);
+        position.unmakeMove();
+    }
+
+    table.store(key, depth, nodes);
+    return nodes;
+}
+
+/*
+ * Run perft from position and print the total node count, time and speed.
+ * The root moves are split across numThreads workers, each pulling the next
+ * unsearched root move from a shared counter into its own copy of the position.
+ * All workers share one perft hash table. With divide, the node count below
+ * every root move is printed as well, in move generation order.
+ */
+void Perft::runPerft(const Position& position, int depth, bool divide, int numThreads, int hashMegabytes)
+{
+    const auto startTime { std::chrono::steady_clock::now() };
+
+    MoveList rootMoves;
+    MoveGen::generateLegalMoves(position, rootMoves);
+
+    PerftTable table { hashMegabytes };
+    std::vector<U64> rootNodes(static_cast<std::size_t>(rootMoves.size()), 0ULL);
+    std::atomic<int> nextRootMove { 0 };
+
+    auto worker = [&]()
+    {
+        Position threadPosition { position };
+        int moveIndex {};
+        while((moveIndex = nextRootMove.fetch_add(1)) < rootMoves.size())
+        {
+            threadPosition.makeMove(rootMoves.moves[moveIndex]);
+            rootNodes[static_cast<std::size_t>(moveIndex)] = perftRecursive(threadPosition, depth - 1, table);
+            threadPosition.unmakeMove();
+        }
+    };
+
+    U64 totalNodes { 1ULL };
+    if(depth > 0)
+    {
+        numThreads = std::max(1, std::min(numThreads, rootMoves.size()));
+        std::vector<std::thread> threads {};
+        for(int i { 1 }; i < numThreads; ++i)
+            threads.emplace_back(worker);
+        worker();
+        for(std::thread& thread : threads)
+            thread.join();
+
+        totalNodes = 0ULL;
+        for(int i { 0 }; i < rootMoves.size(); ++i)
+        {
+            totalNodes += rootNodes[static_cast<std::size_t>(i)];
+            if(divide)
+                uciOutput(moveToString(rootMoves.moves[i]) + ": " + std::to_string(rootNodes[static_cast<std::size_t>(i)]));
+        }
+    }
+
+    const auto elapsed { std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count() };
+    const U64 milliseconds { static_cast<U64>(std::max<decltype(elapsed)>(elapsed, 1)) };
+
+    uciOutput("\nNodes searched: " + std::to_string(totalNodes));
+    uciOutput("Time (ms): " + std::to_string(milliseconds));
+    uciOutput("Nodes per second: " + std::to_string(totalNodes * 1000 / milliseconds));
+}
@@ -0,0 +1,11 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "position.h" // Position
+
+namespace Perft
+{
+    void runPerft(const Position& position, int depth, bool divide, int numThreads, int hashMegabytes);
+}
+
+#endif
@@ -1,15 +1,22 @@
-#include "bitboard.h" // squareToBitboard()
+#include "attack.h" // PAWN_ATTACKS, KNIGHT_ATTACKS, KING_ATTACKS, Attack::getRookAttacks(), Attack::getBishopAttacks()
+#include "bitboard.h" // squareToBitboard(), squaresOf(), lsbIndex()
+#include "eval.h" // PIECE_VALUES
+#include "move.h" // Move, MoveFlag, moveFrom(), moveTo(), moveFlag(), isCapture(), isPromotion(), promotionType()
 #include "position.h"
+#include "nnue.h" // NNUE::isLoaded(), NNUE::refresh(), NNUE::addPiece(), NNUE::removePiece(), NNUE::movePiece()
 #include "prng.h" // PRNG
-#include "types.h" // U64, Piece, LERFSquare, File, Rank, Side, Castle
+#include "psqt.h" // midgamePsqt(), endgamePsqt(), PHASE_WEIGHTS
+#include "types.h" // U64, Piece, LERFSquare, File, Rank, Side, Castle, RayDirection
 
+#include <algorithm> // std::copy(), std::fill(), std::min(), std::max()
 #include <cassert> //assert()
-#include <cctype> // std::isspace(), std::isdigit()
-#include <ios> // std::skipws, std::noskipws
+#include <charconv> // std::from_chars(), std::to_chars()
+#include <cstddef> // std::size_t
+#include <cstring> // std::memcmp()
 #include <iostream> // std::cout
-#include <sstream> // std::istringstream
-#include <string> // std::string, std::string::npos, std::size_t
+#include <iterator> // std::begin(), std::end()
 #include <string_view> // std::string_view, std::string_view::npos
+#include <system_error> // std::errc
 
 /* 
  * Use Zobrist Hashing
@@ -45,19 +52,83 @@ void Position::initZobristPositionKeys()
     }
 }
 
-Position::Position(const std::string& fenString)
+/*
+ * Set up the standard start position. Every other position is set up with
+ * setFromFen(), whose result tells whether the FEN was valid, so a bad FEN
+ * never passes unnoticed as a half initialized position.
+ */
+Position::Position()
 {
-    std::istringstream fenStringStream { fenString };
+    [[maybe_unused]] const FenError error { this->setFromFen(STANDARD_START_FEN) };
+    assert(error == FenError::NONE);
+}
 
-    constexpr std::string_view validPieceChars { "PNBRQKpnbrqk" };
-    constexpr std::string_view validCastlingChars { "KQkq-" };
-    int sq { A8 };
-    U64 sqBB { squareToBitboard(sq) };
-    char fenChar {};
-    int fiftyMoves {};
-    int fullMoves {};
+/*
+ * Map a FEN piece letter to its Piece, or EMPTY if it is not a piece letter.
+ */
+constexpr Piece charToPiece(char pieceChar)
+{
+    switch(pieceChar)
+    {
+        case 'P': return WHITE_PAWN;
+        case 'N': return WHITE_KNIGHT;
+        case 'B': return WHITE_BISHOP;
+        case 'R': return WHITE_ROOK;
+        case 'Q': return WHITE_QUEEN;
+        case 'K': return WHITE_KING;
+        case 'p': return BLACK_PAWN;
+        case 'n': return BLACK_KNIGHT;
+        case 'b': return BLACK_BISHOP;
+        case 'r': return BLACK_ROOK;
+        case 'q': return BLACK_QUEEN;
+        case 'k': return BLACK_KING;
+        default: return EMPTY;
+    }
+}
 
-    fenStringStream >> std::noskipws;
+/*
+ * Split off the next space separated field of a FEN, skipping leading spaces.
+ * Returns an empty view once the input is exhausted.
+ */
+constexpr std::string_view nextFenField(std::string_view& fen)
+{
+    std::size_t fieldStart { fen.find_first_not_of(' ') };
+    if(fieldStart == std::string_view::npos)
+    {
+        fen = {};
+        return {};
+    }
+    fen.remove_prefix(fieldStart);
+    std::size_t fieldEnd { std::min(fen.find(' '), fen.size()) };
+    std::string_view field { fen.substr(0, fieldEnd) };
+    fen.remove_prefix(fieldEnd);
+    return field;
+}
+
+/*
+ * Parse a non-negative decimal number that makes up the whole field.
+ */
+bool parseFenNumber(std::string_view field, int& number)
+{
+    const char* fieldEnd { field.data() + field.size() };
+    auto [parseEnd, errorCode] { std::from_chars(field.data(), fieldEnd, number) };
+    return errorCode == std::errc {} && parseEnd == fieldEnd && number >= 0;
+}
+
+/*
+ * Set up the position from a FEN (Forsyth-Edwards Notation) string, e.g.
+ * "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1".
+ * The input is parsed in place without allocating and fully validated. The
+ * halfmove clock and fullmove number may be omitted, as in EPD, and default to 0 and 1.
+ * Returns FenError::NONE on success. On failure the position is left unchanged.
+ *
+ * As in makeMove(), an en passant square is only kept if a pawn of the side to move
+ * can actually capture there, so equal positions always get equal Zobrist keys.
+ */
+FenError Position::setFromFen(std::string_view fen)
+{
+    Piece newBoard[NUM_SQUARES] {};
+    int pieceCounts[NUM_PIECES] {};
 
     /* 
      * 1. Piece placement (from White's perspective). Each rank is described, starting with rank 8 and ending with rank 1;
@@ -67,78 +138,106 @@ Position::Position(const std::string& fenString)
      * upper-case letters ("PNBRQK") while black pieces use lowercase ("pnbrqk"). Empty squares are noted using digits 1 through 8 
      * (the number of empty squares), and "/" separates ranks.
      */
-    while((fenStringStream >> fenChar) && !std::isspace(fenChar))
+    const std::string_view placement { nextFenField(fen) };
+    int rank { RANK_8 };
+    int file { FILE_A };
+    bool previousWasDigit { false };
+    for(char fenChar : placement)
     {
-        assert((std::isdigit(fenChar)) || (fenChar == '/') || (validPieceChars.find(fenChar) != std::string_view::npos));
-
-        if(std::isdigit(fenChar))
+        if(fenChar >= '1' && fenChar <= '8')
         {
-            // Move along rank by given number of empty squares
-            int moveCount { fenChar - '0' };
-            assert(moveCount >= 1 && moveCount <= 8);
-            sq += moveCount;
+            // Move along rank by given number of empty squares, a run of them is a single digit
+            file += fenChar - '0';
+            if(file > NUM_FILES || previousWasDigit)
+                return FenError::BAD_PIECE_PLACEMENT;
         }
         else if(fenChar == '/')
         {
-            // Move to the next rank towards white
-            sq -= 16;
+            // Move to the next rank towards white, after a complete rank
+            if(file != NUM_FILES || rank == RANK_1)
+                return FenError::BAD_PIECE_PLACEMENT;
+            --rank;
+            file = FILE_A;
         }
         else
         {
-            // Get the Piece enum from character in FEN
-            std::size_t pieceIndex = pieceToChar.find(fenChar);
-            assert(pieceIndex != std::string::npos);
-            assert(pieceIndex < NUM_PIECES);
-
-            // Update Piece Bitboards
-            this->pieceBitboards[pieceIndex] |= sqBB;
-            ++sq;
+            const Piece piece { charToPiece(fenChar) };
+            if(piece == EMPTY || file >= NUM_FILES)
+                return FenError::BAD_PIECE_PLACEMENT;
+            if(typeOfPiece(piece) == PAWN && (rank == RANK_1 || rank == RANK_8))
+                return FenError::BAD_PIECE_PLACEMENT;
+            newBoard[rank * NUM_FILES + file] = piece;
+            ++pieceCounts[piece];
+            ++file;
         }
-        sqBB = squareToBitboard(sq);
-    }
-    // Update Color Bitboards and Occupancy Bitboard
-    this->pieceBitboards[WHITE_ALL] = ( this->pieceBitboards[WHITE_PAWN] | this->pieceBitboards[WHITE_KNIGHT] | 
-                                        this->pieceBitboards[WHITE_BISHOP] | this->pieceBitboards[WHITE_ROOK] | 
-                                        this->pieceBitboards[WHITE_QUEEN] | this->pieceBitboards[WHITE_KING] );
-    this->pieceBitboards[BLACK_ALL] = ( this->pieceBitboards[BLACK_PAWN] | this->pieceBitboards[BLACK_KNIGHT] | 
-                                        this->pieceBitboards[BLACK_BISHOP] | this->pieceBitboards[BLACK_ROOK] | 
-                                        this->pieceBitboards[BLACK_QUEEN] | this->pieceBitboards[BLACK_KING] );
-    this->pieceBitboards[ALL_PIECES] = ( this->pieceBitboards[WHITE_ALL] | this->pieceBitboards[BLACK_ALL] );
-    this->pieceBitboards[EMPTY] = ~pieceBitboards[ALL_PIECES];
+        previousWasDigit = fenChar >= '1' && fenChar <= '8';
+    }
+    if(rank != RANK_1 || file != NUM_FILES)
+        return FenError::BAD_PIECE_PLACEMENT;
+    if(pieceCounts[WHITE_KING] != 1 || pieceCounts[BLACK_KING] != 1)
+        return FenError::BAD_PIECE_PLACEMENT;
+
+    // Only material reachable in a game: at most 8 pawns and 16 pieces per side, and no more
+    // promoted pieces than missing pawns. This also keeps every move list within MAX_MOVES
+    for(Side side : { WHITE, BLACK })
+    {
+        const int pawns { pieceCounts[makePiece(side, PAWN)] };
+        const int promoted { std::max(pieceCounts[makePiece(side, KNIGHT)] - 2, 0) + std::max(pieceCounts[makePiece(side, BISHOP)] - 2, 0)
+                             + std::max(pieceCounts[makePiece(side, ROOK)] - 2, 0) + std::max(pieceCounts[makePiece(side, QUEEN)] - 1, 0) };
+        int pieces { 0 };
+        for(int type { PAWN }; type <= KING; ++type)
+            pieces += pieceCounts[makePiece(side, static_cast<PieceType>(type))];
+        if(pawns > 8 || pieces > 16 || promoted > 8 - pawns)
+            return FenError::BAD_PIECE_PLACEMENT;
+    }
 
     // 2. Active color. "w" means White moves next, "b" means Black moves next.
-    fenStringStream >> fenChar;
-    assert((fenChar == 'w') || (fenChar == 'b'));
-    this->sideToMove = (fenChar == 'w') ? WHITE : BLACK;
-    fenStringStream >> fenChar;
-    assert(std::isspace(fenChar));
+    const std::string_view activeColor { nextFenField(fen) };
+    if(activeColor != "w" && activeColor != "b")
+        return FenError::BAD_SIDE_TO_MOVE;
+    const Side newSideToMove { activeColor == "w" ? WHITE : BLACK };
 
     /* 
      * 3. Castling availability. If neither side can castle, this is "-". Otherwise, this has one or more letters: 
      * "K" (White can castle kingside), "Q" (White can castle queenside), "k" (Black can castle kingside), 
      * and/or "q" (Black can castle queenside). A move that temporarily prevents castling does not negate this notation.
+     * A right is only accepted if its king and rook are still on their start squares.
      */
-    while((fenStringStream >> fenChar) && !std::isspace(fenChar))
+    const std::string_view castling { nextFenField(fen) };
+    int newCastlingRights { 0 };
+    if(castling != "-")
     {
-        assert(validCastlingChars.find(fenChar) != std::string_view::npos);
+        if(castling.empty())
+            return FenError::BAD_CASTLING;
 
-        switch(fenChar)
+        for(char fenChar : castling)
         {
-            case 'K':
-                this->castlingRights += WHITE_KING_CASTLE;
-                break;
-            case 'Q':
-                this->castlingRights += WHITE_QUEEN_CASTLE;
-                break;
-            case 'k':
-                this->castlingRights += BLACK_KING_CASTLE;
-                break;
-            case 'q':
-                this->castlingRights += BLACK_QUEEN_CASTLE;
-                break;
-            default:
-                // '-' No castle rights
-                break;
+            int right {};
+            bool piecesInPlace {};
+            switch(fenChar)
+            {
+                case 'K':
+                    right = WHITE_KING_CASTLE;
+                    piecesInPlace = newBoard[E1] == WHITE_KING && newBoard[H1] == WHITE_ROOK;
+                    break;
+                case 'Q':
+                    right = WHITE_QUEEN_CASTLE;
+                    piecesInPlace = newBoard[E1] == WHITE_KING && newBoard[A1] == WHITE_ROOK;
+                    break;
+                case 'k':
+                    right = BLACK_KING_CASTLE;
+                    piecesInPlace = newBoard[E8] == BLACK_KING && newBoard[H8] == BLACK_ROOK;
+                    break;
+                case 'q':
+                    right = BLACK_QUEEN_CASTLE;
+                    piecesInPlace = newBoard[E8] == BLACK_KING && newBoard[A8] == BLACK_ROOK;
+                    break;
+                default:
+                    return FenError::BAD_CASTLING;
+            }
+            if(!piecesInPlace || (newCastlingRights & right))
+                return FenError::BAD_CASTLING;
+            newCastlingRights |= right;
         }
     }
 
@@ -147,63 +246,198 @@ Position::Position(const std::string& fenString)
      * If a pawn has just made a two-square move, this is the position "behind" the pawn. This is recorded regardless 
      * of whether there is a pawn in position to make an en passant capture.
      */
-    fenStringStream >> fenChar;
-    if(fenChar == '-')
+    const std::string_view enPassant { nextFenField(fen) };
+    LERFSquare newEnPassantSquare { NO_SQ };
+    if(enPassant != "-")
     {
-        this->enPassantSquare = NO_SQ;
+        // The square behind a pawn that just double pushed, on the 6th rank if white is to move, else the 3rd
+        const char expectedRank { newSideToMove == WHITE ? '6' : '3' };
+        if(enPassant.size() != 2 || enPassant[0] < 'a' || enPassant[0] > 'h' || enPassant[1] != expectedRank)
+            return FenError::BAD_EN_PASSANT;
+
+        const int epSq { (enPassant[1] - '1') * NUM_FILES + (enPassant[0] - 'a') };
+        const int pushDirection { newSideToMove == WHITE ? NORTH : SOUTH };
+        const Side them { oppositeSide(newSideToMove) };
+        if(newBoard[epSq - pushDirection] != makePiece(them, PAWN) || newBoard[epSq] != EMPTY || newBoard[epSq + pushDirection] != EMPTY)
+            return FenError::BAD_EN_PASSANT;
+
+        // Keep the square only if a pawn of the side to move can capture there
+        const Side us { newSideToMove };
+        for(int attackerSq : squaresOf(PAWN_ATTACKS[them][epSq]))
+        {
+            if(newBoard[attackerSq] == makePiece(us, PAWN))
+                newEnPassantSquare = static_cast<LERFSquare>(epSq);
+        }
     }
-    else
-    {
-        std::size_t fileIndex = fileToChar.find(fenChar);
-        assert(fileIndex != std::string::npos);
-        assert(fileIndex < NUM_FILES);
 
-        fenStringStream >> fenChar;
+    // 5. Halfmove clock: The number of halfmoves since the last capture or pawn advance, used for the fifty-move rule.
+    // 6. Fullmove number: The number of the full move. It starts at 1, and is incremented after Black's move.
+    int newFiftyMovesCount { 0 };
+    int fullMoves { 1 };
+    const std::string_view halfmoveClock { nextFenField(fen) };
+    const std::string_view fullmoveNumber { nextFenField(fen) };
+    if(!halfmoveClock.empty() && !parseFenNumber(halfmoveClock, newFiftyMovesCount))
+        return FenError::BAD_MOVE_COUNTERS;
+    if(!fullmoveNumber.empty() && (!parseFenNumber(fullmoveNumber, fullMoves) || fullMoves < 1 || fullMoves > MAX_FULL_MOVES))
+        return FenError::BAD_MOVE_COUNTERS;
+    if(!nextFenField(fen).empty())
+        return FenError::TRAILING_CHARACTERS;
 
-        std::size_t rankIndex = rankToChar.find(fenChar);
-        assert(rankIndex != std::string::npos);
-        assert(rankIndex < NUM_RANKS);
+    // 7. Commit the parsed fields, derive the bitboards from the mailbox
+    Piece previousBoard[NUM_SQUARES] {};
+    std::copy(std::begin(this->board), std::end(this->board), previousBoard);
+    U64 previousBitboards[NUM_PIECES_ALL] {};
+    std::copy(std::begin(this->pieceBitboards), std::end(this->pieceBitboards), previousBitboards);
 
-        std::size_t epSq { rankIndex * 8 + fileIndex };
-        assert(epSq <= H8);
-        this->enPassantSquare = static_cast<LERFSquare>(epSq);
+    std::fill(std::begin(this->pieceBitboards), std::end(this->pieceBitboards), 0ULL);
+    for(int sq { A1 }; sq < NUM_SQUARES; ++sq)
+    {
+        this->board[sq] = newBoard[sq];
+        if(newBoard[sq] != EMPTY)
+        {
+            U64 sqBB { squareToBitboard(sq) };
+            this->pieceBitboards[newBoard[sq]] |= sqBB;
+            this->pieceBitboards[sideAllPieces(sideOfPiece(newBoard[sq]))] |= sqBB;
+        }
     }
-    fenStringStream >> fenChar;
-    assert(std::isspace(fenChar));
+    this->pieceBitboards[ALL_PIECES] = this->pieceBitboards[WHITE_ALL] | this->pieceBitboards[BLACK_ALL];
+    this->pieceBitboards[EMPTY] = ~this->pieceBitboards[ALL_PIECES];
 
-    // 5. Halfmove clock: The number of halfmoves since the last capture or pawn advance, used for the fifty-move rule.
-    fenStringStream >> std::skipws;
-    fenStringStream >> fiftyMoves;
-    assert(fiftyMoves >= 0 && fiftyMoves <= 50);
-    this->fiftyMovesCount = fiftyMoves;
+    // The side that just moved must not have left its king in check
+    const Side them { oppositeSide(newSideToMove) };
+    const int theirKingSq { lsbIndex(this->pieceBitboards[makePiece(them, KING)]) };
+    if(this->isSquareAttacked(theirKingSq, newSideToMove, this->pieceBitboards[ALL_PIECES]))
+    {
+        std::copy(std::begin(previousBoard), std::end(previousBoard), this->board);
+        std::copy(std::begin(previousBitboards), std::end(previousBitboards), this->pieceBitboards);
+        return FenError::ILLEGAL_POSITION;
+    }
 
-    // 6. Fullmove number: The number of the full move. It starts at 1, and is incremented after Black's move.
-    fenStringStream >> fullMoves;
-    assert(fullMoves >= 1);
-    this->ply = (fullMoves - 1) * 2 + this->sideToMove;
+    this->sideToMove = newSideToMove;
+    this->castlingRights = newCastlingRights;
+    this->enPassantSquare = newEnPassantSquare;
+    this->fiftyMovesCount = newFiftyMovesCount;
+    this->ply = (fullMoves - 1) * 2 + newSideToMove;
+    this->undoCount = 0;
 
-    // 7. Compute position hash via Zobrist hashing.
+    // 8. Compute position hash via Zobrist hashing, and the evaluation terms.
     this->positionIdentity = this->calculatePositionHash();
+    this->pawnKey = this->calculatePawnKey();
+    this->calculatePsqt(this->midgameScore, this->endgameScore, this->gamePhase);
+    this->refreshAccumulator();
+
+    assert(this->boardIsConsistent());
+    return FenError::NONE;
 }
 
-U64 Position::calculatePositionHash()
+/*
+ * Write the FEN of the position into buffer, NUL terminated, without allocating.
+ * FEN_BUFFER_SIZE bytes are always enough. Returns the length of the FEN,
+ * or 0 if it does not fit into bufferSize bytes.
+ */
+std::size_t Position::toFen(char* buffer, std::size_t bufferSize) const
 {
-    U64 hash { 0 };
+    char fen[FEN_BUFFER_SIZE] {};
+    char* out { fen };
 
-    //Handle piece square keys including empty
-    U64 sqBB {};
-    for(int sq { A1 }; sq < NUM_SQUARES; ++sq)
+    // 1. Piece placement, rank 8 to rank 1, runs of empty squares as digits
+    for(int rank { RANK_8 }; rank >= RANK_1; --rank)
     {
-        sqBB = squareToBitboard(sq);
-        // Loop through piece types
-        for(int pieceType { EMPTY }; pieceType < NUM_PIECES; ++pieceType)
+        int emptyCount { 0 };
+        for(int file { FILE_A }; file < NUM_FILES; ++file)
         {
-            if(this->pieceBitboards[pieceType] & sqBB)
+            const Piece piece { this->board[rank * NUM_FILES + file] };
+            if(piece == EMPTY)
             {
-                hash ^= this->pieceSquareKeys[sq][pieceType];
-                break;
+                ++emptyCount;
+                continue;
             }
+            if(emptyCount)
+                *out++ = static_cast<char>('0' + emptyCount);
+            emptyCount = 0;
+            *out++ = pieceToChar[static_cast<std::size_t>(piece)];
         }
+        if(emptyCount)
+            *out++ = static_cast<char>('0' + emptyCount);
+        if(rank != RANK_1)
+            *out++ = '/';
+    }
+
+    // 2. Active color
+    *out++ = ' ';
+    *out++ = this->sideToMove == WHITE ? 'w' : 'b';
+
+    // 3. Castling availability
+    *out++ = ' ';
+    if(!this->castlingRights)
+        *out++ = '-';
+    if(this->castlingRights & WHITE_KING_CASTLE) *out++ = 'K';
+    if(this->castlingRights & WHITE_QUEEN_CASTLE) *out++ = 'Q';
+    if(this->castlingRights & BLACK_KING_CASTLE) *out++ = 'k';
+    if(this->castlingRights & BLACK_QUEEN_CASTLE) *out++ = 'q';
+
+    // 4. En passant target square
+    *out++ = ' ';
+    if(this->enPassantSquare == NO_SQ)
+    {
+        *out++ = '-';
+    }
+    else
+    {
+        *out++ = fileToChar[static_cast<std::size_t>(this->enPassantSquare % 8)];
+        *out++ = rankToChar[static_cast<std::size_t>(this->enPassantSquare / 8)];
+    }
+
+    // 5. Halfmove clock and 6. fullmove number
+    char* fenEnd { fen + FEN_BUFFER_SIZE - 1 };
+    *out++ = ' ';
+    out = std::to_chars(out, fenEnd, this->fiftyMovesCount).ptr;
+    *out++ = ' ';
+    out = std::to_chars(out, fenEnd, this->ply / 2 + 1).ptr;
+
+    const std::size_t length { static_cast<std::size_t>(out - fen) };
+    if(length + 1 > bufferSize)
+        return 0;
+    std::copy(fen, out, buffer);
+    buffer[length] = '\0';
+    return length;
+}
+
+/*
+ * Short description of a FEN parse error, for reporting bad input.
+ */
+const char* fenErrorToString(FenError error)
+{
+    switch(error)
+    {
+        case FenError::NONE: return "no error";
+        case FenError::BAD_PIECE_PLACEMENT: return "bad piece placement";
+        case FenError::BAD_SIDE_TO_MOVE: return "bad side to move";
+        case FenError::BAD_CASTLING: return "bad castling rights";
+        case FenError::BAD_EN_PASSANT: return "bad en passant square";
+        case FenError::BAD_MOVE_COUNTERS: return "bad halfmove clock or fullmove number";
+        case FenError::TRAILING_CHARACTERS: return "unexpected characters after the fullmove number";
+        case FenError::ILLEGAL_POSITION: return "side not to move is in check";
+    }
+    return "unknown error";
+}
+
+/*
+ * Compute the Zobrist hash of the position from scratch.
+ * Only used when setting up a position, and to verify the
+ * incrementally updated positionIdentity in debug builds.
+ * Empty squares are not hashed, so that makeMove() only needs
+ * to update the keys of the pieces that actually move.
+ */
+U64 Position::calculatePositionHash() const
+{
+    U64 hash { 0 };
+
+    //Handle piece square keys
+    for(int sq { A1 }; sq < NUM_SQUARES; ++sq)
+    {
+        if(this->board[sq] != EMPTY)
+            hash ^= this->pieceSquareKeys[sq][this->board[sq]];
     }
 
     //Handle side to move
@@ -225,26 +459,515 @@ U64 Position::calculatePositionHash()
     return hash;
 }
 
+/*
+ * Compute the pawn hash from scratch, the XOR of the piece square keys
+ * of all white and black pawns.
+ */
+U64 Position::calculatePawnKey() const
+{
+    U64 hash { 0 };
+    for(int sq : squaresOf(this->pieceBitboards[WHITE_PAWN]))
+        hash ^= this->pieceSquareKeys[sq][WHITE_PAWN];
+    for(int sq : squaresOf(this->pieceBitboards[BLACK_PAWN]))
+        hash ^= this->pieceSquareKeys[sq][BLACK_PAWN];
+    return hash;
+}
+
+/*
+ * Sum the piece-square scores and the game phase of all pieces from scratch.
+ * Only used when setting up a position, and to verify the incrementally
+ * updated values in debug builds.
+ */
+void Position::calculatePsqt(int& midgame, int& endgame, int& phase) const
+{
+    midgame = 0;
+    endgame = 0;
+    phase = 0;
+    for(int sq { A1 }; sq < NUM_SQUARES; ++sq)
+    {
+        const Piece piece { this->board[sq] };
+        midgame += midgamePsqt(piece, sq);
+        endgame += endgamePsqt(piece, sq);
+        phase += PHASE_WEIGHTS[typeOfPiece(piece)];
+    }
+}
+
+/*
+ * Recompute the NNUE accumulator from the board. Called when a position is
+ * set up, and for existing positions when a network gets loaded.
+ */
+void Position::refreshAccumulator()
+{
+    if(NNUE::isLoaded())
+        NNUE::refresh(this->accumulator, this->board);
+}
+
+/*
+ * Return true if any piece of attackingSide attacks sq, given a board occupancy.
+ * The occupancy is passed in separately so callers can test squares
+ * with pieces removed, e.g. the king x-rayed by a slider it moves away from.
+ * Pawn attackers are found by looking up the pawn attacks of the opposite
+ * side from sq, since pawn captures are symmetric.
+ */
+bool Position::isSquareAttacked(int sq, Side attackingSide, U64 occupancy) const
+{
+    const U64* pieces { this->pieceBitboards + makePiece(attackingSide, NO_PIECE_TYPE) };
+    U64 rooksQueens { pieces[ROOK] | pieces[QUEEN] };
+    U64 bishopsQueens { pieces[BISHOP] | pieces[QUEEN] };
+
+    return (PAWN_ATTACKS[oppositeSide(attackingSide)][sq] & pieces[PAWN])
+        || (KNIGHT_ATTACKS[sq] & pieces[KNIGHT])
+        || (KING_ATTACKS[sq] & pieces[KING])
+        || (Attack::getRookAttacks(sq, occupancy) & rooksQueens)
+        || (Attack::getBishopAttacks(sq, occupancy) & bishopsQueens);
+}
+
+/*
+ * Piece placement helpers used by makeMove() and unmakeMove().
+ * Each keeps the piece bitboard, the color and occupancy aggregates,
+ * the empty squares, the mailbox, the Zobrist hash, the piece-square
+ * scores, the game phase and the NNUE accumulator in sync.
+ */
+void Position::movePiece(Piece piece, int from, int to)
+{
+    U64 fromToBB { squareToBitboard(from) | squareToBitboard(to) };
+    this->pieceBitboards[piece] ^= fromToBB;
+    this->pieceBitboards[sideAllPieces(sideOfPiece(piece))] ^= fromToBB;
+    this->pieceBitboards[ALL_PIECES] ^= fromToBB;
+    this->pieceBitboards[EMPTY] ^= fromToBB;
+    this->board[from] = EMPTY;
+    this->board[to] = piece;
+    this->positionIdentity ^= this->pieceSquareKeys[from][piece] ^ this->pieceSquareKeys[to][piece];
+    if(typeOfPiece(piece) == PAWN)
+        this->pawnKey ^= this->pieceSquareKeys[from][piece] ^ this->pieceSquareKeys[to][piece];
+    this->midgameScore += midgamePsqt(piece, to) - midgamePsqt(piece, from);
+    this->endgameScore += endgamePsqt(piece, to) - endgamePsqt(piece, from);
+    if(NNUE::isLoaded())
+        NNUE::movePiece(this->accumulator, piece, from, to);
+}
+
+void Position::addPiece(Piece piece, int sq)
+{
+    U64 sqBB { squareToBitboard(sq) };
+    this->pieceBitboards[piece] |= sqBB;
+    this->pieceBitboards[sideAllPieces(sideOfPiece(piece))] |= sqBB;
+    this->pieceBitboards[ALL_PIECES] |= sqBB;
+    this->pieceBitboards[EMPTY] &= ~sqBB;
+    this->board[sq] = piece;
+    this->positionIdentity ^= this->pieceSquareKeys[sq][piece];
+    if(typeOfPiece(piece) == PAWN)
+        this->pawnKey ^= this->pieceSquareKeys[sq][piece];
+    this->midgameScore += midgamePsqt(piece, sq);
+    this->endgameScore += endgamePsqt(piece, sq);
+    this->gamePhase += PHASE_WEIGHTS[typeOfPiece(piece)];
+    if(NNUE::isLoaded())
+        NNUE::addPiece(this->accumulator, piece, sq);
+}
+
+void Position::removePiece(Piece piece, int sq)
+{
+    U64 sqBB { squareToBitboard(sq) };
+    this->pieceBitboards[piece] &= ~sqBB;
+    this->pieceBitboards[sideAllPieces(sideOfPiece(piece))] &= ~sqBB;
+    this->pieceBitboards[ALL_PIECES] &= ~sqBB;
+    this->pieceBitboards[EMPTY] |= sqBB;
+    this->board[sq] = EMPTY;
+    this->positionIdentity ^= this->pieceSquareKeys[sq][piece];
+    if(typeOfPiece(piece) == PAWN)
+        this->pawnKey ^= this->pieceSquareKeys[sq][piece];
+    this->midgameScore -= midgamePsqt(piece, sq);
+    this->endgameScore -= endgamePsqt(piece, sq);
+    this->gamePhase -= PHASE_WEIGHTS[typeOfPiece(piece)];
+    if(NNUE::isLoaded())
+        NNUE::removePiece(this->accumulator, piece, sq);
+}
+
+/*
+ * Debug self-check, compare the incrementally updated hash and pawn key
+ * against a full recomputation. Only called inside assert().
+ */
+bool Position::hashIsConsistent() const
+{
+    return this->positionIdentity == this->calculatePositionHash() && this->pawnKey == this->calculatePawnKey();
+}
+
+/*
+ * Debug self-check, every square of the mailbox must hold exactly the piece
+ * whose bitboard has that square set, and EMPTY where no piece bitboard does.
+ * Only called inside assert().
+ */
+bool Position::boardIsConsistent() const
+{
+    for(int sq { A1 }; sq < NUM_SQUARES; ++sq)
+    {
+        U64 sqBB { squareToBitboard(sq) };
+        for(int piece { EMPTY }; piece < NUM_PIECES; ++piece)
+        {
+            if(static_cast<bool>(this->pieceBitboards[piece] & sqBB) != (this->board[sq] == piece))
+                return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Debug self-check, compare the incrementally updated piece-square scores
+ * and game phase against a full recomputation. Only called inside assert().
+ */
+bool Position::psqtIsConsistent() const
+{
+    int midgame {};
+    int endgame {};
+    int phase {};
+    this->calculatePsqt(midgame, endgame, phase);
+    return midgame == this->midgameScore && endgame == this->endgameScore && phase == this->gamePhase;
+}
+
+/*
+ * Debug self-check, compare the incrementally updated NNUE accumulator
+ * against a full refresh. Only called inside assert().
+ */
+bool Position::accumulatorIsConsistent() const
+{
+    if(!NNUE::isLoaded())
+        return true;
+
+    Accumulator refreshed {};
+    NNUE::refresh(refreshed, this->board);
+    return std::memcmp(refreshed.values, this->accumulator.values, sizeof(refreshed.values)) == 0;
+}
+
+/*
+ * Castling rights left after a move touches a square, indexed by LERFSquare.
+ * Moving the king or a rook, or capturing a rook on its start square,
+ * clears the matching rights: castlingRights &= mask[from] & mask[to].
+ */
+constexpr int CASTLING_RIGHTS_MASK[NUM_SQUARES] {
+    13, 15, 15, 15, 12, 15, 15, 14,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+     7, 15, 15, 15,  3, 15, 15, 11
+};
+
+/*
+ * Make a legal move on the board. The irreversible state is pushed onto the
+ * undo stack, and the Zobrist hash is updated incrementally by XORing out the
+ * old and XORing in the new piece square, castling, en passant and side keys.
+ * The en passant square is only set after a double push if an enemy pawn can
+ * actually capture, so transpositions hash identically.
+ */
+void Position::makeMove(Move move)
+{
+    assert(this->undoCount < MAX_GAME_PLY);
+    UndoState& undo = this->undoStack[this->undoCount++];
+    undo.positionIdentity = this->positionIdentity;
+    undo.move = move;
+    undo.capturedPiece = EMPTY;
+    undo.enPassantSquare = this->enPassantSquare;
+    undo.castlingRights = this->castlingRights;
+    undo.fiftyMovesCount = this->fiftyMovesCount;
+
+    const int from { moveFrom(move) };
+    const int to { moveTo(move) };
+    const int flag { moveFlag(move) };
+    const Side us { this->sideToMove };
+    const Side them { oppositeSide(us) };
+    const Piece piece { this->pieceOn(from) };
+
+    ++this->fiftyMovesCount;
+
+    if(this->enPassantSquare != NO_SQ)
+    {
+        this->positionIdentity ^= this->enPassantFileKeys[this->enPassantSquare % 8];
+        this->enPassantSquare = NO_SQ;
+    }
+
+    // 1. Remove the captured piece
+    if(flag == EN_PASSANT_CAPTURE)
+    {
+        undo.capturedPiece = makePiece(them, PAWN);
+        this->removePiece(undo.capturedPiece, to + (us == WHITE ? SOUTH : NORTH));
+        this->fiftyMovesCount = 0;
+    }
+    else if(isCapture(move))
+    {
+        undo.capturedPiece = this->pieceOn(to);
+        this->removePiece(undo.capturedPiece, to);
+        this->fiftyMovesCount = 0;
+    }
+
+    // 2. Move the piece, and the rook when castling
+    this->movePiece(piece, from, to);
+
+    if(isPromotion(move))
+    {
+        this->removePiece(piece, to);
+        this->addPiece(makePiece(us, promotionType(move)), to);
+    }
+    else if(flag == KING_CASTLE)
+    {
+        this->movePiece(makePiece(us, ROOK), to + EAST, to + WEST);
+    }
+    else if(flag == QUEEN_CASTLE)
+    {
+        this->movePiece(makePiece(us, ROOK), to + 2 * WEST, to + EAST);
+    }
+
+    // 3. Pawn moves reset the fifty move counter, double pushes may set an en passant square
+    if(typeOfPiece(piece) == PAWN)
+    {
+        this->fiftyMovesCount = 0;
+        if(flag == DOUBLE_PAWN_PUSH)
+        {
+            int epSq { (from + to) / 2 };
+            if(PAWN_ATTACKS[us][epSq] & this->pieceBitboards[makePiece(them, PAWN)])
+            {
+                this->enPassantSquare = static_cast<LERFSquare>(epSq);
+                this->positionIdentity ^= this->enPassantFileKeys[epSq % NUM_FILES];
+            }
+        }
+    }
+
+    // 4. Castling rights
+    int newCastlingRights { this->castlingRights & CASTLING_RIGHTS_MASK[from] & CASTLING_RIGHTS_MASK[to] };
+    if(newCastlingRights != this->castlingRights)
+    {
+        this->positionIdentity ^= this->castlingRightKeys[this->castlingRights] ^ this->castlingRightKeys[newCastlingRights];
+        this->castlingRights = newCastlingRights;
+    }
+
+    // 5. Side to move
+    ++this->ply;
+    this->sideToMove = them;
+    this->positionIdentity ^= this->sideToMoveKey;
+
+    assert(this->hashIsConsistent());
+    assert(this->boardIsConsistent());
+    assert(this->psqtIsConsistent());
+    assert(this->accumulatorIsConsistent());
+}
+
+/*
+ * Take back the last move made with makeMove(). Pieces are moved back
+ * with the same helpers, and the irreversible state including the hash
+ * is restored from the undo stack.
+ */
+void Position::unmakeMove()
+{
+    assert(this->undoCount > 0);
+    const UndoState& undo = this->undoStack[--this->undoCount];
+
+    const Move move { undo.move };
+    const int from { moveFrom(move) };
+    const int to { moveTo(move) };
+    const int flag { moveFlag(move) };
+
+    --this->ply;
+    this->sideToMove = oppositeSide(this->sideToMove);
+    const Side us { this->sideToMove };
+
+    if(isPromotion(move))
+    {
+        this->removePiece(makePiece(us, promotionType(move)), to);
+        this->addPiece(makePiece(us, PAWN), to);
+    }
+    else if(flag == KING_CASTLE)
+    {
+        this->movePiece(makePiece(us, ROOK), to + WEST, to + EAST);
+    }
+    else if(flag == QUEEN_CASTLE)
+    {
+        this->movePiece(makePiece(us, ROOK), to + EAST, to + 2 * WEST);
+    }
+
+    this->movePiece(this->pieceOn(to), to, from);
+
+    if(undo.capturedPiece != EMPTY)
+    {
+        int capturedSq { flag == EN_PASSANT_CAPTURE ? to + (us == WHITE ? SOUTH : NORTH) : to };
+        this->addPiece(undo.capturedPiece, capturedSq);
+    }
+
+    this->enPassantSquare = undo.enPassantSquare;
+    this->castlingRights = undo.castlingRights;
+    this->fiftyMovesCount = undo.fiftyMovesCount;
+    this->positionIdentity = undo.positionIdentity;
+
+    assert(this->hashIsConsistent());
+    assert(this->boardIsConsistent());
+    assert(this->psqtIsConsistent());
+    assert(this->accumulatorIsConsistent());
+}
+
+/*
+ * Return true if the king of the side to move is attacked.
+ */
+bool Position::inCheck() const
+{
+    int kingSq { lsbIndex(this->pieceBitboards[makePiece(this->sideToMove, KING)]) };
+    return this->isSquareAttacked(kingSq, oppositeSide(this->sideToMove), this->pieceBitboards[ALL_PIECES]);
+}
+
+/*
+ * Drop the undo records of moves before the last reset of the fifty move counter.
+ * Their positions can never repeat, so only the moves that isRepetition() looks at
+ * are kept, at most MAX_KEPT_HISTORY of them. Called while replaying the game moves
+ * of the GUI, so a long game does not fill the undo stack. The dropped moves
+ * can no longer be taken back.
+ */
+void Position::trimHistory()
+{
+    const int keep { std::min({ this->fiftyMovesCount, this->undoCount, MAX_KEPT_HISTORY }) };
+    std::copy(this->undoStack + this->undoCount - keep, this->undoStack + this->undoCount, this->undoStack);
+    this->undoCount = keep;
+}
+
+/*
+ * Return true if the position repeats an earlier one and so counts as a draw.
+ * The undo stack holds the keys of the game moves sent with "position ... moves"
+ * followed by the moves made in the search, searchPly of them. A repetition within
+ * the search is a draw right away, since the side to move could repeat again.
+ * One reaching back before the root only counts once it is the third occurrence.
+ * Captures and pawn moves cannot be undone, so only the positions since the last
+ * reset of the fifty move counter are compared, and only those with the same side
+ * to move, every second ply from four plies back.
+ */
+bool Position::isRepetition(int searchPly) const
+{
+    const int window { std::min(this->fiftyMovesCount, this->undoCount) };
+    int occurrences { 0 };
+    for(int pliesBack { 4 }; pliesBack <= window; pliesBack += 2)
+    {
+        if(this->undoStack[this->undoCount - pliesBack].positionIdentity != this->positionIdentity)
+            continue;
+        if(pliesBack <= searchPly || ++occurrences == 2)
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Return a bitboard of the pieces of both sides attacking sq, with sliders
+ * seeing through the given occupancy. Passing an occupancy with pieces
+ * removed reveals the sliders behind them (x-rays).
+ */
+U64 Position::attackersTo(int sq, U64 occupancy) const
+{
+    const U64* pieces { this->pieceBitboards };
+    U64 rooksQueens { pieces[WHITE_ROOK] | pieces[WHITE_QUEEN] | pieces[BLACK_ROOK] | pieces[BLACK_QUEEN] };
+    U64 bishopsQueens { pieces[WHITE_BISHOP] | pieces[WHITE_QUEEN] | pieces[BLACK_BISHOP] | pieces[BLACK_QUEEN] };
+
+    return (PAWN_ATTACKS[BLACK][sq] & pieces[WHITE_PAWN])
+        | (PAWN_ATTACKS[WHITE][sq] & pieces[BLACK_PAWN])
+        | (KNIGHT_ATTACKS[sq] & (pieces[WHITE_KNIGHT] | pieces[BLACK_KNIGHT]))
+        | (KING_ATTACKS[sq] & (pieces[WHITE_KING] | pieces[BLACK_KING]))
+        | (Attack::getRookAttacks(sq, occupancy) & rooksQueens)
+        | (Attack::getBishopAttacks(sq, occupancy) & bishopsQueens);
+}
+
+/*
+ * Static Exchange Evaluation, the material balance in centipawns for the side
+ * to move after all captures on the target square of move are played out,
+ * each side always recapturing with its least valuable attacker and free to
+ * stop capturing when that is better. Each piece that captures is removed
+ * from the occupancy, so sliders lined up behind it join the exchange.
+ * Pins are not considered, and the king only captures last.
+ * Credit: https://www.chessprogramming.org/SEE_-_The_Swap_Algorithm
+ */
+int Position::staticExchangeEvaluation(Move move) const
+{
+    const int from { moveFrom(move) };
+    const int to { moveTo(move) };
+    const int flag { moveFlag(move) };
+    if(flag == KING_CASTLE || flag == QUEEN_CASTLE)
+        return 0;
+
+    // gain[d] is the balance after capture d, from the point of view of the side making it
+    int gain[32] {};
+    int depth { 0 };
+    PieceType nextVictim { typeOfPiece(this->board[from]) };
+    if(flag == EN_PASSANT_CAPTURE)
+        gain[0] = PIECE_VALUES[PAWN];
+    else if(isCapture(move))
+        gain[0] = PIECE_VALUES[typeOfPiece(this->board[to])];
+    if(isPromotion(move))
+    {
+        nextVictim = promotionType(move);
+        gain[0] += PIECE_VALUES[nextVictim] - PIECE_VALUES[PAWN];
+    }
+
+    U64 occupancy { this->pieceBitboards[ALL_PIECES] ^ squareToBitboard(from) };
+    if(flag == EN_PASSANT_CAPTURE)
+        occupancy ^= squareToBitboard(to + (this->sideToMove == WHITE ? SOUTH : NORTH));
+    U64 attackers { this->attackersTo(to, occupancy) & occupancy };
+
+    const U64 bishopsQueens { this->pieceBitboards[WHITE_BISHOP] | this->pieceBitboards[WHITE_QUEEN] | this->pieceBitboards[BLACK_BISHOP] | this->pieceBitboards[BLACK_QUEEN] };
+    const U64 rooksQueens { this->pieceBitboards[WHITE_ROOK] | this->pieceBitboards[WHITE_QUEEN] | this->pieceBitboards[BLACK_ROOK] | this->pieceBitboards[BLACK_QUEEN] };
+
+    Side side { oppositeSide(this->sideToMove) };
+    while(depth < 31)
+    {
+        const U64 sideAttackers { attackers & this->pieceBitboards[sideAllPieces(side)] };
+        if(!sideAttackers)
+            break;
+
+        // Least valuable attacker
+        PieceType attackerType { PAWN };
+        U64 attacker { 0ULL };
+        for(; attackerType <= KING; attackerType = static_cast<PieceType>(attackerType + 1))
+        {
+            attacker = sideAttackers & this->pieceBitboards[makePiece(side, attackerType)];
+            if(attacker)
+                break;
+        }
+
+        // The king cannot capture into a square that is still defended
+        if(attackerType == KING && (attackers & this->pieceBitboards[sideAllPieces(oppositeSide(side))]))
+            break;
+
+        ++depth;
+        gain[depth] = PIECE_VALUES[nextVictim] - gain[depth - 1];
+        nextVictim = attackerType;
+
+        // Further captures can only lower gain[depth], so once it is no better than
+        // standing pat this capture is never made, and the exchange is over
+        if(gain[depth] <= -gain[depth - 1])
+        {
+            --depth;
+            break;
+        }
+
+        occupancy ^= attacker & (0ULL - attacker);
+        if(attackerType == PAWN || attackerType == BISHOP || attackerType == QUEEN)
+            attackers |= Attack::getBishopAttacks(to, occupancy) & bishopsQueens;
+        if(attackerType == ROOK || attackerType == QUEEN)
+            attackers |= Attack::getRookAttacks(to, occupancy) & rooksQueens;
+        attackers &= occupancy;
+
+        side = oppositeSide(side);
+    }
+
+    // Negamax the speculative gains back to the first capture
+    while(depth > 0)
+    {
+        gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+        --depth;
+    }
+    return gain[0];
+}
+
 void Position::print()
 {
     // 1. Print 8x8 board to console
-    U64 sqBB {};
-    char pieceChar {};
     for(int rank {RANK_8}; rank >= RANK_1; --rank)
     {
         for(int file {FILE_A}; file <= FILE_H; ++file)
         {
-            sqBB = squareToBitboard(rank * 8 + file);
-
-            for(std::size_t pieceType { EMPTY }; pieceType < NUM_PIECES; ++pieceType)
-            {
-                if(this->pieceBitboards[pieceType] & sqBB)
-                {
-                    pieceChar = pieceToChar[pieceType];
-                    std::cout << pieceChar << ' ';
-                    break;
-                }
-            }
+            std::cout << pieceToChar[static_cast<std::size_t>(this->board[rank * 8 + file])] << ' ';
         }
         std::cout << '\n';
     }
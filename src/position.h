@@ -1,9 +1,13 @@
 #ifndef POSITION_H
 #define POSITION_H
 
+#include "move.h" //Move
+#include "nnue.h" //Accumulator
 #include "types.h" //LERFSquare, Piece, File, Rank, Castle, Side, U64
 
+#include <cstddef> //std::size_t
 #include <string> //std::string
+#include <string_view> //std::string_view
 
 inline const std::string pieceToChar { "-PNBRQKpnbrqk" };
 inline const std::string rankToChar { "12345678" };
@@ -11,6 +15,57 @@ inline const std::string fileToChar { "abcdefgh" };
 
 inline const std::string STANDARD_START_FEN { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1" };
 
+/*
+ * Buffer size that always fits the output of Position::toFen(), including the NUL,
+ * and the largest fullmove number accepted from a FEN.
+ */
+inline constexpr std::size_t FEN_BUFFER_SIZE { 128 };
+inline constexpr int MAX_FULL_MOVES { 1000000 };
+
+/*
+ * Result of Position::setFromFen(), naming the field that failed to parse.
+ */
+enum class FenError
+{
+    NONE,
+    BAD_PIECE_PLACEMENT,
+    BAD_SIDE_TO_MOVE,
+    BAD_CASTLING,
+    BAD_EN_PASSANT,
+    BAD_MOVE_COUNTERS,
+    TRAILING_CHARACTERS,
+    ILLEGAL_POSITION
+};
+
+const char* fenErrorToString(FenError error);
+
+/*
+ * Maximum number of moves that can be made on a Position,
+ * covering the game moves sent by the GUI plus the search tree.
+ */
+inline constexpr int MAX_GAME_PLY { 1024 };
+
+/*
+ * Most game moves kept on the undo stack by trimHistory(), leaving
+ * the rest of it to the search.
+ */
+inline constexpr int MAX_KEPT_HISTORY { MAX_GAME_PLY / 2 };
+
+/*
+ * Irreversible state saved by makeMove() and restored by unmakeMove().
+ * Everything else (piece placement, side to move) can be recomputed
+ * from the move itself.
+ */
+struct UndoState
+{
+    U64 positionIdentity {};
+    Move move {};
+    Piece capturedPiece {};
+    LERFSquare enPassantSquare {};
+    int castlingRights {};
+    int fiftyMovesCount {};
+};
+
 class Position
 {
     private:
@@ -23,17 +78,65 @@ class Position
 
         // Position member variables
         U64 pieceBitboards[NUM_PIECES_ALL] {};
+        Piece board[NUM_SQUARES] {}; // Mailbox, the piece on every square (or EMPTY), kept in sync with pieceBitboards
         LERFSquare enPassantSquare {};
         int castlingRights {};
         int fiftyMovesCount {};
         int ply {};
         U64 positionIdentity {};
+        U64 pawnKey {}; // Zobrist hash of the pawns only, keys the pawn hash table
         Side sideToMove {};
+
+        // Evaluation terms kept up to date by the piece placement helpers, see psqt.h
+        int midgameScore {}; // Material and piece-square sum, from white's point of view
+        int endgameScore {};
+        int gamePhase {};
+        Accumulator accumulator {}; // Only maintained while a network is loaded, see nnue.h
+
+        // Preallocated stack of undo records, one per made move
+        UndoState undoStack[MAX_GAME_PLY] {};
+        int undoCount {};
+
+        void movePiece(Piece piece, int from, int to);
+        void addPiece(Piece piece, int sq);
+        void removePiece(Piece piece, int sq);
+        bool hashIsConsistent() const;
+        bool boardIsConsistent() const;
+        bool psqtIsConsistent() const;
+        void calculatePsqt(int& midgame, int& endgame, int& phase) const;
+        bool accumulatorIsConsistent() const;
     public:
         static void initZobristPositionKeys();
-        explicit Position(const std::string& fenString);
-        U64 calculatePositionHash();
+        Position();
+        FenError setFromFen(std::string_view fen);
+        std::size_t toFen(char* buffer, std::size_t bufferSize) const;
+        U64 calculatePositionHash() const;
+        U64 calculatePawnKey() const;
         void print();
+
+        void makeMove(Move move);
+        void unmakeMove();
+        void trimHistory();
+        Piece pieceOn(int sq) const { return this->board[sq]; }
+        bool isSquareAttacked(int sq, Side attackingSide, U64 occupancy) const;
+        bool inCheck() const;
+        bool isRepetition(int searchPly) const;
+        U64 attackersTo(int sq, U64 occupancy) const;
+        int staticExchangeEvaluation(Move move) const;
+
+        U64 getPieceBitboard(int piece) const { return this->pieceBitboards[piece]; }
+        Side getSideToMove() const { return this->sideToMove; }
+        LERFSquare getEnPassantSquare() const { return this->enPassantSquare; }
+        int getCastlingRights() const { return this->castlingRights; }
+        int getFiftyMovesCount() const { return this->fiftyMovesCount; }
+        int getPly() const { return this->ply; }
+        U64 getPositionIdentity() const { return this->positionIdentity; }
+        U64 getPawnKey() const { return this->pawnKey; }
+        int getMidgameScore() const { return this->midgameScore; }
+        int getEndgameScore() const { return this->endgameScore; }
+        int getGamePhase() const { return this->gamePhase; }
+        const Accumulator& getAccumulator() const { return this->accumulator; }
+        void refreshAccumulator();
 };
 
 #endif
\ No newline at end of file
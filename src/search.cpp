@@ -0,0 +1,700 @@
+#include "bitboard.h" // popcount()
+#include "eval.h" // Eval::evaluate(), PIECE_VALUES
+#include "move.h" // Move, MoveList, NO_MOVE, moveToString(), isCapture(), isPromotion()
+#include "movegen.h" // MoveGen::generateLegalMoves(), MoveGen::isLegal()
+#include "movepick.h" // MovePicker
+#include "pawns.h" // PAWN_TABLES, PawnTablePool
+#include "position.h" // Position
+#include "search.h"
+#include "syzygy.h" // Syzygy::probeWdl(), Syzygy::filterRootMoves(), Syzygy::largestTablebase, WDLScore
+#include "tt.h" // TT, TranspositionTable, TTData, Bound
+#include "types.h" // U64, PieceType, ALL_PIECES
+#include "uci.h" // uciOutput()
+
+#include <algorithm> // std::max(), std::min()
+#include <atomic> // std::atomic, std::memory_order_relaxed
+#include <chrono> // std::chrono::steady_clock, std::chrono::duration_cast
+#include <cstdlib> // std::abs()
+#include <cstddef> // std::size_t
+#include <iomanip> // std::setprecision()
+#include <ios> // std::fixed
+#include <memory> // std::make_unique(), std::unique_ptr
+#include <sstream> // std::ostringstream
+#include <string> // std::string, std::to_string()
+#include <thread> // std::thread
+#include <vector> // std::vector
+
+/*
+ * Mate and tablebase scores are stored in the transposition table relative to the node
+ * they were found at, rather than to the root, so they stay correct when
+ * the entry is probed from a different ply.
+ */
+int scoreToTT(int score, int ply)
+{
+    if(score >= TB_WIN_IN_MAX_PLY) return score + ply;
+    if(score <= -TB_WIN_IN_MAX_PLY) return score - ply;
+    return score;
+}
+
+int scoreFromTT(int score, int ply)
+{
+    if(score >= TB_WIN_IN_MAX_PLY) return score - ply;
+    if(score <= -TB_WIN_IN_MAX_PLY) return score + ply;
+    return score;
+}
+
+/*
+ * Lazy SMP depth skipping. Helper thread i skips an iteration when
+ * ((depth + SKIP_PHASE[i]) / SKIP_SIZE[i]) is odd, so the helpers spread out
+ * over neighbouring depths instead of all searching the same tree in lockstep.
+ * Credit: Stockfish 9, https://github.com/official-stockfish/Stockfish
+ */
+constexpr int SKIP_PATTERNS { 20 };
+constexpr int SKIP_SIZE[SKIP_PATTERNS] { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+constexpr int SKIP_PHASE[SKIP_PATTERNS] { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+
+/*
+ * Safety margin of delta pruning in the quiescence search, covering
+ * positional gains the static evaluation may see after a capture.
+ */
+constexpr int DELTA_MARGIN { 200 };
+
+SearchStats& SearchStats::operator+=(const SearchStats& other)
+{
+    this->mainNodes += other.mainNodes;
+    this->quiescenceNodes += other.quiescenceNodes;
+    this->ttProbes += other.ttProbes;
+    this->ttHits += other.ttHits;
+    this->ttCutoffs += other.ttCutoffs;
+    this->betaCutoffs += other.betaCutoffs;
+    this->firstMoveCutoffs += other.firstMoveCutoffs;
+    this->nullWindowSearches += other.nullWindowSearches;
+    this->researches += other.researches;
+    return *this;
+}
+
+SearchWorker::SearchWorker(const Position& rootPosition, SharedSearchState& sharedState, int id)
+    : position { rootPosition }, shared { sharedState }, threadId { id }, pawnTable { sharedState.pawnTables.forThread(id) }
+{
+}
+
+long long SearchWorker::elapsedMilliseconds() const
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - this->shared.startTime).count();
+}
+
+/*
+ * Sum the node counters of all workers. Each counter has a single writer
+ * and is read here with relaxed loads, so counting costs no locked instructions.
+ */
+U64 SearchWorker::totalNodes() const
+{
+    U64 total { 0ULL };
+    for(const SearchWorker* worker : this->shared.workers)
+        total += worker->getNodes();
+    return total;
+}
+
+/*
+ * Raise the stop flag once the node or time limit is reached.
+ * Reading the clock is comparatively slow, so it is only called every few thousand nodes.
+ * While pondering the clock is not ours, so the time limits wait for the ponderhit.
+ * The time spent pondering counts towards them, so a search that would already
+ * have stopped moves right after the ponderhit.
+ */
+void SearchWorker::checkLimits()
+{
+    if(this->shared.ponderFlag.load(std::memory_order_relaxed))
+        return;
+
+    const int maximumTime { this->shared.timeManager.getMaximumTime() };
+    if(this->stopOnPonderHit || (maximumTime && this->elapsedMilliseconds() >= maximumTime))
+        this->shared.stopFlag.store(true, std::memory_order_relaxed);
+}
+
+/*
+ * Count a visited node, checking the node and time limits,
+ * and return whether the search has to stop.
+ */
+bool SearchWorker::countNode()
+{
+    const U64 nodeCount { this->nodes.load(std::memory_order_relaxed) + 1 };
+    this->nodes.store(nodeCount, std::memory_order_relaxed);
+
+    // The node limit is for all workers together. Summing their counters takes a pass
+    // over the workers, so with helper threads it is only checked every 1024 nodes
+    const U64 nodeLimit { this->shared.limits.nodes };
+    if(nodeLimit && (this->shared.workers.size() == 1 ? nodeCount >= nodeLimit
+                                                      : (nodeCount & 1023) == 0 && this->totalNodes() >= nodeLimit))
+        this->shared.stopFlag.store(true, std::memory_order_relaxed);
+    if((nodeCount & 2047) == 0)
+        this->checkLimits();
+    return this->shared.stopFlag.load(std::memory_order_relaxed);
+}
+
+/*
+ * Reward a quiet move that caused a beta cutoff. Deeper cutoffs weigh more.
+ * All entries are halved once any of them grows too large, so the table
+ * keeps adapting to the current part of the tree.
+ * The move also becomes the first killer of its ply, cutoffs by the same quiet
+ * move are likely in the sibling nodes.
+ */
+void SearchWorker::updateQuietStats(Move move, int depth, int ply)
+{
+    Move (&killers)[2] = this->searchStack[ply].killers;
+    if(killers[0] != move)
+    {
+        killers[1] = killers[0];
+        killers[0] = move;
+    }
+
+    int& entry = this->history[this->position.getSideToMove()][moveFrom(move)][moveTo(move)];
+    entry += depth * depth;
+    if(entry > 80000)
+    {
+        for(auto& sideHistory : this->history)
+            for(auto& fromHistory : sideHistory)
+                for(int& toHistory : fromHistory)
+                    toHistory /= 2;
+    }
+}
+
+/*
+ * Make move the best line from ply, followed by the line found from ply + 1.
+ */
+void SearchWorker::updatePv(int ply, Move move)
+{
+    this->pvTable[ply][ply] = move;
+    for(int nextPly { ply + 1 }; nextPly < this->pvLength[ply + 1]; ++nextPly)
+        this->pvTable[ply][nextPly] = this->pvTable[ply + 1][nextPly];
+    this->pvLength[ply] = this->pvLength[ply + 1];
+}
+
+/*
+ * Quiescence search, resolving the captures left at the horizon of the main search
+ * so that positions are only evaluated once they are quiet.
+ * - Stand pat: the side to move may decline every capture, so the static
+ *   evaluation is a lower bound on the score.
+ * - Delta pruning: a capture that cannot lift the static evaluation to alpha
+ *   even with a safety margin is skipped, and so is every capture losing material
+ *   by static exchange evaluation.
+ * - In check standing pat is not allowed, all evasions are searched instead.
+ * Credit: https://www.chessprogramming.org/Quiescence_Search
+ */
+int SearchWorker::quiescence(int alpha, int beta, int ply)
+{
+    this->pvLength[ply] = ply;
+
+    if(this->countNode())
+        return 0;
+    statsIncrement(this->stats.quiescenceNodes);
+
+    if(ply >= MAX_PLY)
+        return Eval::evaluate(this->position, this->pawnTable);
+
+    const bool inCheck { this->position.inCheck() };
+    int bestScore { -INFINITE_SCORE };
+    int standPat { 0 };
+    if(!inCheck)
+    {
+        standPat = Eval::evaluate(this->position, this->pawnTable);
+        if(standPat >= beta)
+            return standPat;
+        alpha = std::max(alpha, standPat);
+        bestScore = standPat;
+    }
+
+    // Out of check the picker holds back the captures losing material by SEE
+    MovePicker movePicker { this->position, this->history[this->position.getSideToMove()] };
+    Move move { NO_MOVE };
+    while((move = movePicker.nextMove()) != NO_MOVE)
+    {
+        if(!inCheck)
+        {
+            const PieceType victim { moveFlag(move) == EN_PASSANT_CAPTURE ? PAWN : typeOfPiece(this->position.pieceOn(moveTo(move))) };
+            const int promotionGain { isPromotion(move) ? PIECE_VALUES[QUEEN] - PIECE_VALUES[PAWN] : 0 };
+            if(standPat + PIECE_VALUES[victim] + promotionGain + DELTA_MARGIN <= alpha)
+                continue;
+        }
+
+        this->position.makeMove(move);
+        const int score { -this->quiescence(-beta, -alpha, ply + 1) };
+        this->position.unmakeMove();
+
+        if(this->shared.stopFlag.load(std::memory_order_relaxed))
+            return 0;
+
+        if(score > bestScore)
+        {
+            bestScore = score;
+            if(score > alpha)
+            {
+                alpha = score;
+                this->updatePv(ply, move);
+                if(alpha >= beta)
+                    break;
+            }
+        }
+    }
+
+    // In check with no evasion at all
+    if(bestScore == -INFINITE_SCORE)
+        return -MATE_SCORE + ply;
+
+    return bestScore;
+}
+
+/*
+ * Principal variation search (PVS) in negamax form. The first move of a node
+ * is searched with the full window, all later moves with a null window around
+ * alpha, and only re-searched with the full window if they unexpectedly raise alpha.
+ * Credit: Tony Marsland and Murray Campbell, "Parallel search of strongly ordered
+ * game trees", 1982, and https://www.chessprogramming.org/Principal_Variation_Search
+ */
+int SearchWorker::alphaBeta(int alpha, int beta, int depth, int ply)
+{
+    if(depth <= 0)
+        return this->quiescence(alpha, beta, ply);
+
+    const bool pvNode { beta - alpha > 1 };
+    this->pvLength[ply] = ply;
+
+    if(this->countNode())
+        return 0;
+    statsIncrement(this->stats.mainNodes);
+
+    if(ply > 0)
+    {
+        if(this->position.isRepetition(ply))
+            return DRAW_SCORE;
+
+        // The fifty move rule draws, unless the move reaching it mated
+        if(this->position.getFiftyMovesCount() >= 100)
+        {
+            MoveList moveList;
+            MoveGen::generateLegalMoves(this->position, moveList);
+            if(moveList.size() > 0 || !this->position.inCheck())
+                return DRAW_SCORE;
+        }
+
+        // Mate distance pruning, no line from here can beat a shorter mate already found
+        alpha = std::max(alpha, -MATE_SCORE + ply);
+        beta = std::min(beta, MATE_SCORE - ply - 1);
+        if(alpha >= beta)
+            return alpha;
+    }
+
+    if(ply >= MAX_PLY)
+        return Eval::evaluate(this->position, this->pawnTable);
+
+    const bool inCheck { this->position.inCheck() };
+    if(inCheck)
+        ++depth;
+
+    // Transposition table lookup
+    const U64 key { this->position.getPositionIdentity() };
+    TTData ttData {};
+    Move ttMove { NO_MOVE };
+    statsIncrement(this->stats.ttProbes);
+    if(this->shared.transpositionTable.probe(key, ttData))
+    {
+        statsIncrement(this->stats.ttHits);
+        ttMove = ttData.move;
+        int ttScore { scoreFromTT(ttData.score, ply) };
+        if(!pvNode && ttData.depth >= depth
+            && (ttData.bound == BOUND_EXACT
+                || (ttData.bound == BOUND_LOWER && ttScore >= beta)
+                || (ttData.bound == BOUND_UPPER && ttScore <= alpha)))
+        {
+            statsIncrement(this->stats.ttCutoffs);
+            return ttScore;
+        }
+    }
+
+    // Tablebase probe. The WDL tables ignore the fifty move counter, so they are only
+    // probed right after a zeroing move, and positions with castling rights are not stored.
+    // Cursed wins and blessed losses score just off the draw.
+    if(ply > 0 && Syzygy::largestTablebase
+        && this->position.getFiftyMovesCount() == 0
+        && !this->position.getCastlingRights()
+        && popcount(this->position.getPieceBitboard(ALL_PIECES)) <= Syzygy::largestTablebase)
+    {
+        WDLScore wdl { WDL_DRAW };
+        if(Syzygy::probeWdl(this->position, wdl))
+        {
+            const int tbScore { wdl == WDL_WIN ? TB_WIN_SCORE - ply : wdl == WDL_LOSS ? -TB_WIN_SCORE + ply : DRAW_SCORE + wdl };
+            const Bound tbBound { wdl == WDL_WIN ? BOUND_LOWER : wdl == WDL_LOSS ? BOUND_UPPER : BOUND_EXACT };
+            if(tbBound == BOUND_EXACT
+                || (tbBound == BOUND_LOWER && tbScore >= beta)
+                || (tbBound == BOUND_UPPER && tbScore <= alpha))
+            {
+                this->shared.transpositionTable.store(key, NO_MOVE, scoreToTT(tbScore, ply), 0, std::min(MAX_PLY - 1, depth + 6), tbBound);
+                return tbScore;
+            }
+        }
+    }
+
+    const int staticEval { inCheck ? 0 : Eval::evaluate(this->position, this->pawnTable) };
+    this->searchStack[ply].staticEval = staticEval;
+
+    MovePicker movePicker { this->position, this->history[this->position.getSideToMove()], ttMove,
+                            this->searchStack[ply].killers[0], this->searchStack[ply].killers[1] };
+
+    int bestScore { -INFINITE_SCORE };
+    Move bestMove { NO_MOVE };
+    int moveCount { 0 };
+    Move move { NO_MOVE };
+    while((move = movePicker.nextMove()) != NO_MOVE)
+    {
+        if(ply == 0 && !this->isRootMove(move))
+            continue;
+
+        ++moveCount;
+        this->searchStack[ply].currentMove = move;
+
+        this->position.makeMove(move);
+        this->shared.transpositionTable.prefetch(this->position.getPositionIdentity());
+
+        int score {};
+        if(moveCount == 1)
+        {
+            score = -this->alphaBeta(-beta, -alpha, depth - 1, ply + 1);
+        }
+        else
+        {
+            statsIncrement(this->stats.nullWindowSearches);
+            score = -this->alphaBeta(-alpha - 1, -alpha, depth - 1, ply + 1);
+            if(score > alpha && score < beta)
+            {
+                statsIncrement(this->stats.researches);
+                score = -this->alphaBeta(-beta, -alpha, depth - 1, ply + 1);
+            }
+        }
+
+        this->position.unmakeMove();
+
+        if(this->shared.stopFlag.load(std::memory_order_relaxed))
+            return 0;
+
+        if(score > bestScore)
+        {
+            bestScore = score;
+            if(score > alpha)
+            {
+                alpha = score;
+                bestMove = move;
+                this->updatePv(ply, move);
+
+                if(alpha >= beta)
+                {
+                    statsIncrement(this->stats.betaCutoffs);
+                    if(moveCount == 1)
+                        statsIncrement(this->stats.firstMoveCutoffs);
+                    if(!isCapture(move) && !isPromotion(move))
+                        this->updateQuietStats(move, depth, ply);
+                    break;
+                }
+            }
+        }
+    }
+
+    if(moveCount == 0)
+        return inCheck ? -MATE_SCORE + ply : DRAW_SCORE;
+
+    Bound bound { bestScore >= beta ? BOUND_LOWER : (bestMove != NO_MOVE ? BOUND_EXACT : BOUND_UPPER) };
+    this->shared.transpositionTable.store(key, bestMove, scoreToTT(bestScore, ply), staticEval, depth, bound);
+
+    return bestScore;
+}
+
+bool SearchWorker::isRootMove(Move move) const
+{
+    for(Move rootMove : this->shared.rootMoves)
+    {
+        if(rootMove == move)
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Format a score the UCI way, cp <x> or mate <y>, where y is in moves
+ * and negative when the side to move gets mated.
+ */
+std::string scoreToString(int score)
+{
+    if(score >= MATE_IN_MAX_PLY)
+        return "mate " + std::to_string((MATE_SCORE - score + 1) / 2);
+    if(score <= -MATE_IN_MAX_PLY)
+        return "mate " + std::to_string(-(MATE_SCORE + score) / 2);
+    return "cp " + std::to_string(score);
+}
+
+/*
+ * info depth <x> score <cp <x> | mate <y>> nodes <x> nps <x> hashfull <x> time <x> pv <move1> ... <movei>
+ */
+void SearchWorker::printInfo(int depth, int score) const
+{
+    const long long milliseconds { std::max(this->elapsedMilliseconds(), 1LL) };
+    const U64 nodeCount { this->totalNodes() };
+
+    std::ostringstream info {};
+    info << "info depth " << depth << " score " << scoreToString(score)
+         << " nodes " << nodeCount
+         << " nps " << nodeCount * 1000 / static_cast<U64>(milliseconds)
+         << " hashfull " << this->shared.transpositionTable.hashfull()
+         << " time " << milliseconds
+         << " pv";
+    for(int ply { 0 }; ply < this->pvLength[0]; ++ply)
+        info << ' ' << moveToString(this->pvTable[0][ply]);
+    uciOutput(info.str());
+}
+
+/*
+ * Percentage of part in total, 0 for an empty total.
+ */
+double percentage(U64 part, U64 total)
+{
+    return total ? 100.0 * static_cast<double>(part) / static_cast<double>(total) : 0.0;
+}
+
+/*
+ * Report the statistics of a finished search, summed over all workers, as info strings.
+ */
+void printStats(const SearchStats& stats, long long milliseconds)
+{
+    const U64 nodeCount { stats.mainNodes + stats.quiescenceNodes };
+    std::ostringstream lines {};
+    lines << std::fixed << std::setprecision(1);
+    lines << "info string stats nodes " << nodeCount << " main " << stats.mainNodes
+          << " quiescence " << stats.quiescenceNodes << " (" << percentage(stats.quiescenceNodes, nodeCount) << "%)"
+          << " nps " << nodeCount * 1000 / static_cast<U64>(std::max(milliseconds, 1LL)) << '\n';
+    lines << "info string stats tt probes " << stats.ttProbes
+          << " hits " << stats.ttHits << " (" << percentage(stats.ttHits, stats.ttProbes) << "%)"
+          << " cutoffs " << stats.ttCutoffs << " (" << percentage(stats.ttCutoffs, stats.ttProbes) << "%)" << '\n';
+    lines << "info string stats cutoffs " << stats.betaCutoffs
+          << " first move " << stats.firstMoveCutoffs << " (" << percentage(stats.firstMoveCutoffs, stats.betaCutoffs) << "%)" << '\n';
+    lines << "info string stats null window searches " << stats.nullWindowSearches
+          << " re-searches " << stats.researches << " (" << percentage(stats.researches, stats.nullWindowSearches) << "%)";
+    uciOutput(lines.str());
+}
+
+/*
+ * Search the root position to increasing depths until a limit is reached.
+ * Each completed iteration seeds the transposition table with a better move
+ * ordering for the next one. An iteration interrupted by the stop flag is
+ * discarded, and the best move of the last completed iteration is kept.
+ * Only the main worker (thread 0) reports info lines, helpers skip depths
+ * according to their skip pattern.
+ */
+void SearchWorker::iterativeDeepening()
+{
+    const MoveList& rootMoves = this->shared.rootMoves;
+    if(rootMoves.size() == 0)
+    {
+        this->bestScore = this->position.inCheck() ? -MATE_SCORE : DRAW_SCORE;
+        return;
+    }
+
+    this->bestMove = rootMoves.moves[0];
+    double bestMoveChanges { 0.0 };
+    long long iterationStart { 0 };
+    for(int depth { 1 }; depth <= this->shared.limits.depth; ++depth)
+    {
+        if(this->threadId > 0)
+        {
+            int pattern { (this->threadId - 1) % SKIP_PATTERNS };
+            if(((depth + this->position.getPly() + SKIP_PHASE[pattern]) / SKIP_SIZE[pattern]) % 2)
+                continue;
+        }
+
+        int score { this->alphaBeta(-INFINITE_SCORE, INFINITE_SCORE, depth, 0) };
+
+        if(this->shared.stopFlag.load(std::memory_order_relaxed))
+            break;
+
+        // Older best move changes count for less, a recent change makes the position unstable
+        bestMoveChanges /= 2;
+        if(depth > 1 && this->pvTable[0][0] != this->bestMove)
+            bestMoveChanges += 1.0;
+
+        this->bestMove = this->pvTable[0][0];
+        this->ponderMove = this->pvLength[0] > 1 ? this->pvTable[0][1] : NO_MOVE;
+        this->bestScore = score;
+        this->completedDepth = depth;
+        if(this->threadId == 0 && this->shared.reportInfo)
+            this->printInfo(depth, score);
+        if constexpr(STATS_ENABLED)
+        {
+            if(this->threadId == 0 && this->shared.reportStats)
+                uciOutput("info string stats depth " + std::to_string(depth) + " iteration time "
+                          + std::to_string(this->elapsedMilliseconds() - iterationStart) + " ms");
+        }
+
+        // A mate proven within the searched depth cannot be improved upon by searching deeper,
+        // but UCI forbids ending a ponder search on its own, even when it is mate
+        const bool pondering { this->shared.ponderFlag.load(std::memory_order_relaxed) };
+        if(!this->shared.limits.infinite && !pondering && std::abs(score) >= MATE_IN_MAX_PLY && MATE_SCORE - std::abs(score) <= depth)
+            break;
+
+        // While pondering, a search out of time keeps going until the ponderhit, then stops at once
+        if(this->threadId == 0)
+        {
+            const long long elapsed { this->elapsedMilliseconds() };
+            const double instability { 0.6 + std::min(bestMoveChanges, 2.0) * 0.7 };
+            if(this->shared.timeManager.stopIterating(elapsed, elapsed - iterationStart, instability))
+            {
+                if(!pondering)
+                    break;
+                this->stopOnPonderHit = true;
+            }
+            iterationStart = elapsed;
+        }
+    }
+}
+
+/*
+ * Run a Lazy SMP search on position with the given limits, and return the best move.
+ * All threads search the same root, sharing only the transposition table,
+ * which is how the helpers speed up the main thread. Once the main thread
+ * finishes, the helpers are stopped, and the result of the thread that
+ * completed the deepest iteration is returned (the main thread on ties).
+ */
+SearchResult Search::go(const Position& position, const SearchLimits& limits, TranspositionTable& transpositionTable,
+                        PawnTablePool& pawnTables, int numThreads, std::atomic<bool>& stopFlag, const std::atomic<bool>& ponderFlag,
+                        bool reportInfo, bool reportStats)
+{
+    const std::chrono::steady_clock::time_point startTime { std::chrono::steady_clock::now() };
+    TimeManager timeManager {};
+    timeManager.init(limits, position.getSideToMove());
+
+    SharedSearchState shared { transpositionTable, pawnTables, limits, timeManager, stopFlag, ponderFlag, startTime, {}, reportInfo, reportStats, {} };
+    MoveGen::generateLegalMoves(position, shared.rootMoves);
+    if(Syzygy::largestTablebase)
+    {
+        Position rootPosition { position };
+        Syzygy::filterRootMoves(rootPosition, shared.rootMoves);
+    }
+    transpositionTable.newSearch();
+    pawnTables.reserve(numThreads);
+
+    std::vector<std::unique_ptr<SearchWorker>> workers {};
+    for(int id { 0 }; id < numThreads; ++id)
+    {
+        workers.push_back(std::make_unique<SearchWorker>(position, shared, id));
+        shared.workers.push_back(workers.back().get());
+    }
+
+    std::vector<std::thread> helperThreads {};
+    for(std::size_t id { 1 }; id < workers.size(); ++id)
+        helperThreads.emplace_back(&SearchWorker::iterativeDeepening, workers[id].get());
+
+    workers[0]->iterativeDeepening();
+    stopFlag.store(true, std::memory_order_relaxed);
+    for(std::thread& thread : helperThreads)
+        thread.join();
+
+    const SearchWorker* bestWorker { workers[0].get() };
+    SearchResult result {};
+    SearchStats stats {};
+    for(const auto& worker : workers)
+    {
+        result.nodes += worker->getNodes();
+        stats += worker->getStats();
+        if(worker->getCompletedDepth() > bestWorker->getCompletedDepth()
+            && (worker->getBestScore() >= bestWorker->getBestScore() || worker->getBestScore() >= MATE_IN_MAX_PLY))
+        {
+            bestWorker = worker.get();
+        }
+    }
+
+    result.bestMove = bestWorker->getBestMove();
+    result.ponderMove = bestWorker->getPonderMove();
+    result.score = bestWorker->getBestScore();
+    result.depth = bestWorker->getCompletedDepth();
+
+    // Without a reply in the PV, e.g. when it ends in a draw by repetition, fall back to the hash move
+    if(result.ponderMove == NO_MOVE && result.bestMove != NO_MOVE)
+    {
+        Position afterBestMove { position };
+        afterBestMove.makeMove(result.bestMove);
+        TTData ttData {};
+        if(transpositionTable.probe(afterBestMove.getPositionIdentity(), ttData) && ttData.move != NO_MOVE
+            && MoveGen::isLegal(afterBestMove, ttData.move))
+        {
+            result.ponderMove = ttData.move;
+        }
+    }
+
+    if constexpr(STATS_ENABLED)
+    {
+        if(reportStats)
+            printStats(stats, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
+    }
+    return result;
+}
+
+SearchController::~SearchController()
+{
+    this->stop();
+    this->wait();
+}
+
+/*
+ * Start searching position on the search thread, after any previous search has finished.
+ * In infinite mode the best move is held back until "stop" is received, and in ponder
+ * mode until "ponderhit" or "stop", as UCI requires.
+ */
+void SearchController::start(const Position& position, const SearchLimits& limits, int numThreads, bool reportStats)
+{
+    this->wait();
+    this->stopFlag.store(false);
+    this->stopRequested.store(false);
+    this->ponderFlag.store(limits.ponder);
+
+    this->searchThread = std::thread([this, position, limits, numThreads, reportStats]()
+    {
+        SearchResult result { Search::go(position, limits, TT, PAWN_TABLES, numThreads, this->stopFlag, this->ponderFlag, true, reportStats) };
+
+        if(limits.infinite)
+            this->stopRequested.wait(false);
+        this->ponderFlag.wait(true);
+
+        std::string bestMoveLine { "bestmove " + moveToString(result.bestMove) };
+        if(result.ponderMove != NO_MOVE)
+            bestMoveLine += " ponder " + moveToString(result.ponderMove);
+        uciOutput(bestMoveLine);
+    });
+}
+
+/*
+ * Signal the search to stop. The workers poll the flag at every node,
+ * so the best move follows within microseconds.
+ */
+void SearchController::stop()
+{
+    this->stopFlag.store(true);
+    this->stopRequested.store(true);
+    this->stopRequested.notify_all();
+    this->ponderFlag.store(false);
+    this->ponderFlag.notify_all();
+}
+
+/*
+ * The opponent played the move pondered on. The search goes on where it is,
+ * only now under its time limits.
+ */
+void SearchController::ponderHit()
+{
+    this->ponderFlag.store(false);
+    this->ponderFlag.notify_all();
+}
+
+/*
+ * Block until the current search, if any, has printed its best move.
+ */
+void SearchController::wait()
+{
+    if(this->searchThread.joinable())
+        this->searchThread.join();
+}
@@ -0,0 +1,215 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "move.h" // Move, MoveList
+#include "pawns.h" // PawnTable, PawnTablePool
+#include "position.h" // Position
+#include "timeman.h" // TimeManager
+#include "tt.h" // TranspositionTable
+#include "types.h" // U64, NUM_SIDES, NUM_SQUARES
+
+#include <atomic> // std::atomic
+#include <chrono> // std::chrono::steady_clock
+#include <string> // std::string
+#include <thread> // std::thread
+#include <vector> // std::vector
+
+inline constexpr int MAX_PLY { 128 };
+inline constexpr int INFINITE_SCORE { 32000 };
+inline constexpr int MATE_SCORE { 31000 };
+inline constexpr int MATE_IN_MAX_PLY { MATE_SCORE - MAX_PLY };
+inline constexpr int TB_WIN_SCORE { MATE_IN_MAX_PLY - 1 }; // Tablebase win, below every mate score
+inline constexpr int TB_WIN_IN_MAX_PLY { TB_WIN_SCORE - MAX_PLY };
+inline constexpr int DRAW_SCORE { 0 };
+inline constexpr int MAX_THREADS { 512 };
+
+// The undo stack holds the kept game moves plus the moves of the deepest search line
+static_assert(MAX_KEPT_HISTORY + MAX_PLY < MAX_GAME_PLY, "Undo stack too small for the search");
+
+// Search statistics are only counted in builds with STATS=yes, elsewhere the counting compiles to nothing
+#if defined(USE_STATS)
+inline constexpr bool STATS_ENABLED { true };
+#else
+inline constexpr bool STATS_ENABLED { false };
+#endif
+
+/*
+ * Limits of a search, as given by the UCI "go" command.
+ * A value of 0 means the limit is not set.
+ */
+struct SearchLimits
+{
+    int depth { MAX_PLY - 1 };
+    U64 nodes { 0 };
+    int moveTime { 0 };
+    int time[NUM_SIDES] {};
+    int increment[NUM_SIDES] {};
+    int movesToGo { 0 };
+    bool infinite { false };
+    bool ponder { false };
+};
+
+/*
+ * Counters describing where a search spends its nodes, kept per worker
+ * with a single writer each and summed once the search is over.
+ * First move cutoffs over all cutoffs measures the move ordering, and
+ * re-searches over null window searches how often PVS guessed wrong.
+ */
+struct SearchStats
+{
+    U64 mainNodes { 0 };
+    U64 quiescenceNodes { 0 };
+    U64 ttProbes { 0 };
+    U64 ttHits { 0 };
+    U64 ttCutoffs { 0 };
+    U64 betaCutoffs { 0 };
+    U64 firstMoveCutoffs { 0 };
+    U64 nullWindowSearches { 0 };
+    U64 researches { 0 };
+
+    SearchStats& operator+=(const SearchStats& other);
+};
+
+inline void statsIncrement(U64& counter)
+{
+    if constexpr(STATS_ENABLED)
+        ++counter;
+}
+
+class SearchWorker;
+
+/*
+ * State shared by all threads of one search. The workers only read it,
+ * except for the stop flag, which any worker may raise.
+ * The ponder flag is set while the engine searches on the opponent's time,
+ * and cleared by "ponderhit" or "stop". Until then the time limits do not apply.
+ * rootMoves are the moves searched at the root, all legal moves unless
+ * the tablebases ruled some out.
+ */
+struct SharedSearchState
+{
+    TranspositionTable& transpositionTable;
+    PawnTablePool& pawnTables;
+    const SearchLimits& limits;
+    const TimeManager& timeManager;
+    std::atomic<bool>& stopFlag;
+    const std::atomic<bool>& ponderFlag;
+    std::chrono::steady_clock::time_point startTime;
+    std::vector<const SearchWorker*> workers;
+    bool reportInfo;
+    bool reportStats;
+    MoveList rootMoves;
+};
+
+/*
+ * Per ply search stack entry. The killers are the last two quiet moves
+ * that caused a beta cutoff at this ply.
+ */
+struct SearchStackEntry
+{
+    int staticEval {};
+    Move currentMove {};
+    Move killers[2] {};
+};
+
+/*
+ * A single searcher. Everything it mutates is either owned by the worker
+ * (its copy of the position, node counter, search stack, PV and history tables)
+ * or reached through the SharedSearchState handed to it on construction,
+ * so any number of workers can search side by side.
+ * Workers are aligned to a cache line so that the hot per-thread data of
+ * two threads never shares a line.
+ */
+class alignas(64) SearchWorker
+{
+    private:
+        Position position;
+        SharedSearchState& shared;
+        const int threadId;
+        std::atomic<U64> nodes {};
+        int completedDepth {};
+        int bestScore {};
+        Move bestMove {};
+        Move ponderMove {};
+        bool stopOnPonderHit {};
+        SearchStats stats {};
+
+        SearchStackEntry searchStack[MAX_PLY + 1] {};
+
+        // Pawn structure cache, private to the worker so probing needs no locks
+        PawnTable& pawnTable;
+
+        // Butterfly history, indexed by [side][from][to], rewards quiet moves causing beta cutoffs
+        int history[NUM_SIDES][NUM_SQUARES][NUM_SQUARES] {};
+
+        // Triangular PV table, pvTable[ply] holds the best line found from ply
+        Move pvTable[MAX_PLY + 1][MAX_PLY + 1] {};
+        int pvLength[MAX_PLY + 1] {};
+
+        int alphaBeta(int alpha, int beta, int depth, int ply);
+        bool isRootMove(Move move) const;
+        int quiescence(int alpha, int beta, int ply);
+        void updatePv(int ply, Move move);
+        void updateQuietStats(Move move, int depth, int ply);
+        void checkLimits();
+        bool countNode();
+        long long elapsedMilliseconds() const;
+        U64 totalNodes() const;
+        void printInfo(int depth, int score) const;
+    public:
+        SearchWorker(const Position& rootPosition, SharedSearchState& sharedState, int id);
+        void iterativeDeepening();
+        U64 getNodes() const { return this->nodes.load(std::memory_order_relaxed); }
+        int getCompletedDepth() const { return this->completedDepth; }
+        int getBestScore() const { return this->bestScore; }
+        Move getBestMove() const { return this->bestMove; }
+        Move getPonderMove() const { return this->ponderMove; }
+        const SearchStats& getStats() const { return this->stats; }
+};
+
+/*
+ * Outcome of a search, as reported with "bestmove". The ponder move is the
+ * expected reply to the best move, NO_MOVE if none is known.
+ */
+struct SearchResult
+{
+    Move bestMove {};
+    Move ponderMove {};
+    int score {};
+    int depth {};
+    U64 nodes {};
+};
+
+namespace Search
+{
+    SearchResult go(const Position& position, const SearchLimits& limits, TranspositionTable& transpositionTable,
+                    PawnTablePool& pawnTables, int numThreads, std::atomic<bool>& stopFlag, const std::atomic<bool>& ponderFlag,
+                    bool reportInfo, bool reportStats = false);
+}
+
+std::string scoreToString(int score);
+
+/*
+ * Runs UCI searches on a background thread, so the input thread stays free
+ * to answer "isready" and to deliver "stop" while the engine is thinking.
+ */
+class SearchController
+{
+    private:
+        std::thread searchThread {};
+        std::atomic<bool> stopFlag { false };
+        std::atomic<bool> stopRequested { false };
+        std::atomic<bool> ponderFlag { false };
+    public:
+        SearchController() = default;
+        SearchController(const SearchController&) = delete;
+        SearchController& operator=(const SearchController&) = delete;
+        ~SearchController();
+
+        void start(const Position& position, const SearchLimits& limits, int numThreads, bool reportStats);
+        void stop();
+        void ponderHit();
+        void wait();
+};
+
+#endif
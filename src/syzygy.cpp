@@ -0,0 +1,1202 @@
+#include "syzygy.h"
+#include "attack.h" // KING_ATTACKS
+#include "bitboard.h" // popcount(), popLSB(), squareToBitboard()
+#include "mappedfile.h" // MappedFile
+#include "move.h" // Move, MoveList, moveFrom(), isCapture()
+#include "movegen.h" // MoveGen::generateLegalMoves()
+#include "position.h" // Position, pieceToChar
+#include "types.h" // U64, Piece, PieceType, Side, NUM_SQUARES, ALL_PIECES, makePiece(), typeOfPiece(), sideOfPiece()
+
+#include <algorithm> // std::max(), std::min(), std::max_element(), std::stable_sort(), std::count_if(), std::swap()
+#include <array> // std::array
+#include <atomic> // std::atomic, std::memory_order_acquire, std::memory_order_release
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint8_t, std::uint16_t, std::uint32_t, std::uint64_t
+#include <cstring> // std::memcmp()
+#include <fstream> // std::ifstream
+#include <limits> // std::numeric_limits
+#include <memory> // std::unique_ptr, std::make_unique()
+#include <mutex> // std::mutex, std::lock_guard
+#include <string> // std::string
+#include <string_view> // std::string_view
+#include <unordered_map> // std::unordered_map
+#include <vector> // std::vector
+
+/*
+ * The probing code follows the reference implementation by Ronald de Man,
+ * in the C++ form it was given in Stockfish.
+ * Credit: https://github.com/syzygy1/tb and https://github.com/official-stockfish/Stockfish
+ */
+constexpr int TB_PIECES { 7 };
+
+enum TableType : int
+{
+    WDL_TABLE, DTZ_TABLE, NUM_TABLE_TYPES
+};
+
+/*
+ * Per table flags, stored in the first byte of its size information.
+ */
+enum TableFlag : int
+{
+    FLAG_STM = 1, FLAG_MAPPED = 2, FLAG_WIN_PLIES = 4, FLAG_LOSS_PLIES = 8, FLAG_WIDE = 16, FLAG_SINGLE_VALUE = 128
+};
+
+/*
+ * PROBE_CHANGE_STM: the DTZ table only stores the other side to move.
+ * PROBE_ZEROING_BEST_MOVE: the best move resets the fifty move counter, so the stored DTZ does not apply.
+ */
+enum ProbeState : int
+{
+    PROBE_FAIL, PROBE_OK, PROBE_CHANGE_STM, PROBE_ZEROING_BEST_MOVE
+};
+
+constexpr std::uint8_t TABLE_MAGICS[NUM_TABLE_TYPES][4] { { 0x71, 0xE8, 0x23, 0x5D }, { 0xD7, 0x66, 0x0C, 0xA5 } };
+
+/*
+ * Distance of sq from the a1-h8 diagonal, negative below it.
+ */
+constexpr int offA1H8(int sq)
+{
+    return sq / NUM_FILES - sq % NUM_FILES;
+}
+
+/*
+ * Index tables of the position encoding, generated at compile time.
+ *
+ * mapB1H1H7       squares below the a1-h8 diagonal to 0..27
+ * mapA1D1D4       the a1-d1-d4 triangle to 0..9, diagonal squares last
+ * mapKK           the 462 legal placements of two kings, the first in the a1-d1-d4 triangle
+ * binomial[k][n]  ways to choose k of n squares
+ * mapPawns        a2-h7 to 0..47, the leading pawn is the one with the highest value
+ * leadPawnIdx     start index of the leading pawns group for the leading pawn square
+ * leadPawnsSize   size of the leading pawns group for each leading pawn file
+ */
+struct EncodingTables
+{
+    int mapB1H1H7[NUM_SQUARES] {};
+    int mapA1D1D4[NUM_SQUARES] {};
+    int mapKK[10][NUM_SQUARES] {};
+    int binomial[6][NUM_SQUARES] {};
+    int mapPawns[NUM_SQUARES] {};
+    int leadPawnIdx[6][NUM_SQUARES] {};
+    int leadPawnsSize[6][4] {};
+};
+
+constexpr EncodingTables makeEncodingTables()
+{
+    EncodingTables tables {};
+
+    int code { 0 };
+    for(int sq { A1 }; sq <= H8; ++sq)
+    {
+        if(offA1H8(sq) < 0)
+            tables.mapB1H1H7[sq] = code++;
+    }
+
+    code = 0;
+    int diagonal[4] {};
+    int diagonalCount { 0 };
+    for(int sq { A1 }; sq <= D4; ++sq)
+    {
+        if(offA1H8(sq) < 0 && sq % NUM_FILES <= FILE_D)
+            tables.mapA1D1D4[sq] = code++;
+        else if(offA1H8(sq) == 0 && sq % NUM_FILES <= FILE_D)
+            diagonal[diagonalCount++] = sq;
+    }
+    for(int i { 0 }; i < diagonalCount; ++i)
+        tables.mapA1D1D4[diagonal[i]] = code++;
+
+    // If the first king is on the diagonal the second must not be above it,
+    // placements with both kings on the diagonal come last
+    code = 0;
+    int bothOnDiagonal[NUM_SQUARES][2] {};
+    int bothOnDiagonalCount { 0 };
+    for(int idx { 0 }; idx < 10; ++idx)
+    {
+        for(int sq1 { A1 }; sq1 <= D4; ++sq1)
+        {
+            if(tables.mapA1D1D4[sq1] != idx || (idx == 0 && sq1 != B1))
+                continue;
+
+            for(int sq2 { A1 }; sq2 <= H8; ++sq2)
+            {
+                if((KING_ATTACKS[sq1] | squareToBitboard(sq1)) & squareToBitboard(sq2))
+                    continue;
+                if(offA1H8(sq1) == 0 && offA1H8(sq2) > 0)
+                    continue;
+
+                if(offA1H8(sq1) == 0 && offA1H8(sq2) == 0)
+                {
+                    bothOnDiagonal[bothOnDiagonalCount][0] = idx;
+                    bothOnDiagonal[bothOnDiagonalCount++][1] = sq2;
+                }
+                else
+                {
+                    tables.mapKK[idx][sq2] = code++;
+                }
+            }
+        }
+    }
+    for(int i { 0 }; i < bothOnDiagonalCount; ++i)
+        tables.mapKK[bothOnDiagonal[i][0]][bothOnDiagonal[i][1]] = code++;
+
+    tables.binomial[0][0] = 1;
+    for(int n { 1 }; n < NUM_SQUARES; ++n)
+    {
+        for(int k { 0 }; k < 6 && k <= n; ++k)
+            tables.binomial[k][n] = (k > 0 ? tables.binomial[k - 1][n - 1] : 0) + (k < n ? tables.binomial[k][n - 1] : 0);
+    }
+
+    // The index restarts on every file, the tables of pawn endgames are split by leading pawn file
+    int availableSquares { 47 };
+    for(int leadPawnsCount { 1 }; leadPawnsCount <= 5; ++leadPawnsCount)
+    {
+        for(int file { FILE_A }; file <= FILE_D; ++file)
+        {
+            int idx { 0 };
+            for(int rank { RANK_2 }; rank <= RANK_7; ++rank)
+            {
+                const int sq { rank * NUM_FILES + file };
+                if(leadPawnsCount == 1)
+                {
+                    tables.mapPawns[sq] = availableSquares--;
+                    tables.mapPawns[sq ^ 7] = availableSquares--;
+                }
+                tables.leadPawnIdx[leadPawnsCount][sq] = idx;
+                idx += tables.binomial[leadPawnsCount - 1][tables.mapPawns[sq]];
+            }
+            tables.leadPawnsSize[leadPawnsCount][file] = idx;
+        }
+    }
+
+    return tables;
+}
+
+constexpr EncodingTables ENCODING { makeEncodingTables() };
+
+static_assert(ENCODING.mapKK[9][H8] == 461, "The two kings have 462 placements");
+
+/*
+ * Low level decoding information of one subtable. A table has one subtable per
+ * side to move it stores (WDL tables of unequal material store both), and
+ * pawn tables one per leading pawn file, a to d.
+ */
+struct PairsData
+{
+    int flags {};
+    int maxSymLen {};
+    int minSymLen {};
+    std::uint32_t numBlocks {};
+    std::size_t blockSize {};
+    std::size_t span {}; // About every span values there is a sparse index entry
+    const std::uint8_t* lowestSym { nullptr }; // LE16 [symbol length], lowest symbol of each length
+    const std::uint8_t* btree { nullptr }; // 3 bytes [symbol], the pair a symbol expands into
+    const std::uint8_t* blockLength { nullptr }; // LE16 [block], values in the block minus one
+    std::size_t blockLengthSize {};
+    const std::uint8_t* sparseIndex { nullptr }; // 6 bytes [entry], LE32 block and LE16 offset within it
+    std::size_t sparseIndexSize {};
+    const std::uint8_t* data { nullptr }; // Huffman coded blocks
+    std::vector<std::uint64_t> base64 {}; // Lowest symbol of each length, left aligned to 64 bits
+    std::vector<std::uint8_t> symlen {}; // Values represented by each symbol, minus one
+    int pieces[TB_PIECES] {}; // Table piece codes, in the order they are encoded
+    std::uint64_t groupIdx[TB_PIECES + 1] {};
+    int groupLen[TB_PIECES + 1] {}; // Pieces per encoding group, zero terminated
+    int mapIdx[4] {}; // DTZ value map offsets for win, loss, cursed win and blessed loss
+};
+
+/*
+ * One .rtbw or .rtbz file. Only the existence of the WDL file is checked on init,
+ * each file is mapped and parsed the first time it is probed.
+ */
+struct TableFile
+{
+    std::atomic<bool> ready { false };
+    MappedFile file {};
+    PairsData items[NUM_SIDES][4] {}; // [side to move][leading pawn file]
+    const std::uint8_t* dtzMap { nullptr };
+};
+
+/*
+ * A material configuration, like KRvK. Tables are generated with the stronger
+ * side as white: key is the material key with the pieces as named, key2 with
+ * colours swapped, so both KRvK and KvKR positions find this entry.
+ */
+struct TablebaseEntry
+{
+    std::string name {};
+    U64 key {};
+    U64 key2 {};
+    int pieceCount {};
+    bool hasPawns {};
+    bool hasUniquePieces {};
+    int pawnCount[NUM_SIDES] {}; // [leading colour, other colour]
+    TableFile tables[NUM_TABLE_TYPES] {};
+};
+
+std::vector<std::string> tablebasePaths {};
+std::vector<std::unique_ptr<TablebaseEntry>> tablebaseEntries {};
+std::unordered_map<U64, TablebaseEntry*> tablebaseKeys {};
+
+template<typename T>
+T readLittleEndian(const std::uint8_t* data)
+{
+    T value { 0 };
+    for(std::size_t i { 0 }; i < sizeof(T); ++i)
+        value = static_cast<T>(value | static_cast<T>(static_cast<T>(data[i]) << (8 * i)));
+    return value;
+}
+
+template<typename T>
+T readBigEndian(const std::uint8_t* data)
+{
+    T value { 0 };
+    for(std::size_t i { 0 }; i < sizeof(T); ++i)
+        value = static_cast<T>(static_cast<T>(value << 8) | data[i]);
+    return value;
+}
+
+/*
+ * Piece code used by the tables: the piece type for white, plus 8 for black.
+ * Squares are numbered a1 = 0 to h8 = 63 like LERFSquare, so they need no conversion.
+ */
+constexpr int tablebasePiece(Piece piece)
+{
+    return sideOfPiece(piece) == WHITE ? static_cast<int>(piece) : typeOfPiece(piece) + 8;
+}
+
+/*
+ * 4 bits per piece count, from WHITE_PAWN to BLACK_KING.
+ */
+U64 materialKey(const int (&counts)[NUM_PIECES])
+{
+    U64 key { 0ULL };
+    for(int piece { WHITE_PAWN }; piece <= BLACK_KING; ++piece)
+        key |= static_cast<U64>(counts[piece]) << (4 * (piece - WHITE_PAWN));
+    return key;
+}
+
+U64 materialKey(const Position& position)
+{
+    int counts[NUM_PIECES] {};
+    for(int piece { WHITE_PAWN }; piece <= BLACK_KING; ++piece)
+        counts[piece] = popcount(position.getPieceBitboard(piece));
+    return materialKey(counts);
+}
+
+PairsData& pairsData(TablebaseEntry& entry, TableType type, int stm, int file)
+{
+    return entry.tables[type].items[type == WDL_TABLE ? stm : 0][entry.hasPawns ? file : 0];
+}
+
+/*
+ * Full name of fileName in the first SyzygyPath directory holding it, empty if none does.
+ */
+std::string findTableFile(const std::string& fileName)
+{
+    for(const std::string& path : tablebasePaths)
+    {
+        const std::string fullName { path + "/" + fileName };
+        if(std::ifstream { fullName, std::ios::binary })
+            return fullName;
+    }
+    return std::string {};
+}
+
+/*
+ * Split the pieces of a subtable into encoding groups and compute the index
+ * factor of each group. The leading group holds the leading pawns, or the first
+ * two (three with unique pieces) pieces, every later group identical pieces.
+ */
+void setGroups(const TablebaseEntry& entry, PairsData& d, const int (&order)[2], int file)
+{
+    int n { 0 };
+    int firstLen { entry.hasPawns ? 0 : entry.hasUniquePieces ? 3 : 2 };
+    d.groupLen[n] = 1;
+    for(int i { 1 }; i < entry.pieceCount; ++i)
+    {
+        if(--firstLen > 0 || d.pieces[i] != d.pieces[i - 1])
+            d.groupLen[++n] = 1;
+        else
+            ++d.groupLen[n];
+    }
+    d.groupLen[++n] = 0;
+
+    // The groups are encoded in a per table order, order[0] is the position of
+    // the leading group and order[1] the one of the remaining pawns
+    const bool bothPawns { entry.hasPawns && entry.pawnCount[1] > 0 };
+    int next { bothPawns ? 2 : 1 };
+    int freeSquares { NUM_SQUARES - d.groupLen[0] - (bothPawns ? d.groupLen[1] : 0) };
+    std::uint64_t idx { 1 };
+    for(int k { 0 }; next < n || k == order[0] || k == order[1]; ++k)
+    {
+        if(k == order[0])
+        {
+            d.groupIdx[0] = idx;
+            idx *= static_cast<std::uint64_t>(entry.hasPawns ? ENCODING.leadPawnsSize[d.groupLen[0]][file] : entry.hasUniquePieces ? 31332 : 462);
+        }
+        else if(k == order[1])
+        {
+            d.groupIdx[1] = idx;
+            idx *= static_cast<std::uint64_t>(ENCODING.binomial[d.groupLen[1]][48 - d.groupLen[0]]);
+        }
+        else
+        {
+            d.groupIdx[next] = idx;
+            idx *= static_cast<std::uint64_t>(ENCODING.binomial[d.groupLen[next]][freeSquares]);
+            freeSquares -= d.groupLen[next++];
+        }
+    }
+    d.groupIdx[n] = idx;
+}
+
+int btreeLeft(const PairsData& d, int sym)
+{
+    const std::uint8_t* entry { d.btree + 3 * sym };
+    return ((entry[1] & 0xF) << 8) | entry[0];
+}
+
+int btreeRight(const PairsData& d, int sym)
+{
+    const std::uint8_t* entry { d.btree + 3 * sym };
+    return (entry[2] << 4) | (entry[1] >> 4);
+}
+
+/*
+ * Number of values a symbol expands into, minus one. Symbols are built by
+ * recursive pairing, a leaf has 0xFFF as right symbol and stores the value as left symbol.
+ */
+std::uint8_t setSymlen(PairsData& d, int sym, std::vector<bool>& visited)
+{
+    visited[static_cast<std::size_t>(sym)] = true;
+    const int right { btreeRight(d, sym) };
+    if(right == 0xFFF)
+        return 0;
+
+    const int left { btreeLeft(d, sym) };
+    if(!visited[static_cast<std::size_t>(left)])
+        d.symlen[static_cast<std::size_t>(left)] = setSymlen(d, left, visited);
+    if(!visited[static_cast<std::size_t>(right)])
+        d.symlen[static_cast<std::size_t>(right)] = setSymlen(d, right, visited);
+    return static_cast<std::uint8_t>(d.symlen[static_cast<std::size_t>(left)] + d.symlen[static_cast<std::size_t>(right)] + 1);
+}
+
+/*
+ * Read the size information and Huffman code of a subtable, return the data following it.
+ */
+const std::uint8_t* setSizes(PairsData& d, const std::uint8_t* data)
+{
+    d.flags = *data++;
+    if(d.flags & FLAG_SINGLE_VALUE)
+    {
+        d.minSymLen = *data++; // The single value
+        return data;
+    }
+
+    int groups { 0 };
+    while(d.groupLen[groups])
+        ++groups;
+    const std::uint64_t tableSize { d.groupIdx[groups] };
+
+    d.blockSize = std::size_t { 1 } << *data++;
+    d.span = std::size_t { 1 } << *data++;
+    d.sparseIndexSize = static_cast<std::size_t>((tableSize + d.span - 1) / d.span);
+    const int padding { *data++ };
+    d.numBlocks = readLittleEndian<std::uint32_t>(data);
+    data += sizeof(std::uint32_t);
+    d.blockLengthSize = d.numBlocks + static_cast<std::size_t>(padding); // Padded so the sparse index stays in range
+    d.maxSymLen = *data++;
+    d.minSymLen = *data++;
+    d.lowestSym = data;
+
+    // Longer canonical codes have lower values, base64[i] >= base64[i + 1]
+    // and a symbol of length i left aligned to 64 bits lies in [base64[i], base64[i - 1])
+    const std::size_t lengths { static_cast<std::size_t>(d.maxSymLen - d.minSymLen + 1) };
+    d.base64.assign(lengths, 0);
+    for(std::size_t i { lengths - 1 }; i-- > 0;)
+    {
+        d.base64[i] = (d.base64[i + 1] + readLittleEndian<std::uint16_t>(d.lowestSym + 2 * i)
+                       - readLittleEndian<std::uint16_t>(d.lowestSym + 2 * (i + 1))) / 2;
+    }
+    for(std::size_t i { 0 }; i < lengths; ++i)
+        d.base64[i] <<= 64 - i - static_cast<std::size_t>(d.minSymLen);
+    data += lengths * sizeof(std::uint16_t);
+
+    const std::size_t symbols { readLittleEndian<std::uint16_t>(data) };
+    data += sizeof(std::uint16_t);
+    d.symlen.assign(symbols, 0);
+    d.btree = data;
+
+    std::vector<bool> visited(symbols);
+    for(std::size_t sym { 0 }; sym < symbols; ++sym)
+    {
+        if(!visited[sym])
+            d.symlen[sym] = setSymlen(d, static_cast<int>(sym), visited);
+    }
+
+    return data + 3 * symbols + (symbols & 1);
+}
+
+/*
+ * DTZ tables may store their values through a map, one per WDL result.
+ */
+const std::uint8_t* setDtzMap(TableFile& table, const std::uint8_t* data, const std::uint8_t* base, int maxFile)
+{
+    table.dtzMap = data;
+    for(int file { FILE_A }; file <= maxFile; ++file)
+    {
+        PairsData& d = table.items[0][file];
+        if(!(d.flags & FLAG_MAPPED))
+            continue;
+
+        if(d.flags & FLAG_WIDE)
+        {
+            data += (data - base) & 1;
+            for(int i { 0 }; i < 4; ++i)
+            {
+                d.mapIdx[i] = static_cast<int>((data - table.dtzMap) / 2 + 1);
+                data += 2 * readLittleEndian<std::uint16_t>(data) + 2;
+            }
+        }
+        else
+        {
+            for(int i { 0 }; i < 4; ++i)
+            {
+                d.mapIdx[i] = static_cast<int>(data - table.dtzMap + 1);
+                data += *data + 1;
+            }
+        }
+    }
+    return data + ((data - base) & 1);
+}
+
+/*
+ * Parse a freshly mapped file. base points to the magic number at its start.
+ */
+void setupTable(TablebaseEntry& entry, TableType type, const std::uint8_t* base)
+{
+    TableFile& table = entry.tables[type];
+    const std::uint8_t* data { base + 5 }; // Magic number and header byte
+
+    const int sides { type == WDL_TABLE && entry.key != entry.key2 ? 2 : 1 };
+    const int maxFile { entry.hasPawns ? FILE_D : FILE_A };
+    const bool bothPawns { entry.hasPawns && entry.pawnCount[1] > 0 };
+
+    for(int file { FILE_A }; file <= maxFile; ++file)
+    {
+        const int order[NUM_SIDES][2] {
+            { data[0] & 0xF, bothPawns ? data[1] & 0xF : 0xF },
+            { data[0] >> 4, bothPawns ? data[1] >> 4 : 0xF }
+        };
+        data += 1 + bothPawns;
+
+        for(int k { 0 }; k < entry.pieceCount; ++k, ++data)
+        {
+            for(int side { 0 }; side < sides; ++side)
+                table.items[side][file].pieces[k] = side ? *data >> 4 : *data & 0xF;
+        }
+        for(int side { 0 }; side < sides; ++side)
+            setGroups(entry, table.items[side][file], order[side], file);
+    }
+    data += (data - base) & 1;
+
+    for(int file { FILE_A }; file <= maxFile; ++file)
+        for(int side { 0 }; side < sides; ++side)
+            data = setSizes(table.items[side][file], data);
+
+    if(type == DTZ_TABLE)
+        data = setDtzMap(table, data, base, maxFile);
+
+    for(int file { FILE_A }; file <= maxFile; ++file)
+    {
+        for(int side { 0 }; side < sides; ++side)
+        {
+            table.items[side][file].sparseIndex = data;
+            data += table.items[side][file].sparseIndexSize * 6;
+        }
+    }
+
+    for(int file { FILE_A }; file <= maxFile; ++file)
+    {
+        for(int side { 0 }; side < sides; ++side)
+        {
+            table.items[side][file].blockLength = data;
+            data += table.items[side][file].blockLengthSize * sizeof(std::uint16_t);
+        }
+    }
+
+    for(int file { FILE_A }; file <= maxFile; ++file)
+    {
+        for(int side { 0 }; side < sides; ++side)
+        {
+            data = base + (((data - base) + 0x3F) & ~0x3F); // Blocks start 64 byte aligned
+            table.items[side][file].data = data;
+            data += table.items[side][file].numBlocks * table.items[side][file].blockSize;
+        }
+    }
+}
+
+/*
+ * Map and parse the table of type on its first probe, under a lock so that only
+ * one search thread does it. Return whether the table is available.
+ */
+bool mapTable(TablebaseEntry& entry, TableType type)
+{
+    TableFile& table = entry.tables[type];
+    if(table.ready.load(std::memory_order_acquire))
+        return table.file.isOpen();
+
+    static std::mutex mapMutex {};
+    const std::lock_guard<std::mutex> lock { mapMutex };
+    if(table.ready.load(std::memory_order_relaxed))
+        return table.file.isOpen();
+
+    const std::string fileName { findTableFile(entry.name + (type == WDL_TABLE ? ".rtbw" : ".rtbz")) };
+    if(!fileName.empty() && table.file.open(fileName, true))
+    {
+        // Valid files hold the magic number and 64 byte aligned data, plus a 16 byte checksum
+        const std::string_view view { table.file.view() };
+        const std::uint8_t* base { reinterpret_cast<const std::uint8_t*>(view.data()) };
+        if(view.size() % 64 != 16 || std::memcmp(base, TABLE_MAGICS[type], 4) != 0)
+            table.file.close();
+        else
+            setupTable(entry, type, base);
+    }
+
+    table.ready.store(true, std::memory_order_release);
+    return table.file.isOpen();
+}
+
+/*
+ * Decode the value at index idx of a subtable.
+ */
+int decompressPairs(const PairsData& d, std::uint64_t idx)
+{
+    if(d.flags & FLAG_SINGLE_VALUE)
+        return d.minSymLen;
+
+    // Every span values there is a sparse index entry pointing at the block and the offset
+    // within it of value k * span + span / 2, walk the block lengths from there
+    const std::uint64_t k { idx / d.span };
+    const std::uint8_t* sparseEntry { d.sparseIndex + 6 * k };
+    std::uint32_t block { readLittleEndian<std::uint32_t>(sparseEntry) };
+    int offset { readLittleEndian<std::uint16_t>(sparseEntry + 4) };
+    offset += static_cast<int>(idx % d.span) - static_cast<int>(d.span / 2);
+
+    while(offset < 0)
+        offset += readLittleEndian<std::uint16_t>(d.blockLength + 2 * --block) + 1;
+    while(offset > readLittleEndian<std::uint16_t>(d.blockLength + 2 * block))
+        offset -= readLittleEndian<std::uint16_t>(d.blockLength + 2 * block++) + 1;
+
+    // Read Huffman symbols from the start of the block until the one holding offset
+    const std::uint8_t* pointer { d.data + static_cast<std::uint64_t>(block) * d.blockSize };
+    std::uint64_t buffer { readBigEndian<std::uint64_t>(pointer) };
+    pointer += sizeof(std::uint64_t);
+    int bufferSize { 64 };
+    int sym {};
+    while(true)
+    {
+        std::size_t len { 0 };
+        while(buffer < d.base64[len])
+            ++len;
+
+        sym = static_cast<int>((buffer - d.base64[len]) >> (64 - len - static_cast<std::size_t>(d.minSymLen)));
+        sym += readLittleEndian<std::uint16_t>(d.lowestSym + 2 * len);
+        if(offset < d.symlen[static_cast<std::size_t>(sym)] + 1)
+            break;
+
+        offset -= d.symlen[static_cast<std::size_t>(sym)] + 1;
+        const int bits { static_cast<int>(len) + d.minSymLen };
+        buffer <<= bits;
+        bufferSize -= bits;
+        if(bufferSize <= 32)
+        {
+            bufferSize += 32;
+            buffer |= static_cast<std::uint64_t>(readBigEndian<std::uint32_t>(pointer)) << (64 - bufferSize);
+            pointer += sizeof(std::uint32_t);
+        }
+    }
+
+    // The symbol expands into symlen + 1 values, descend into the pair holding offset
+    while(d.symlen[static_cast<std::size_t>(sym)])
+    {
+        const int left { btreeLeft(d, sym) };
+        if(offset < d.symlen[static_cast<std::size_t>(left)] + 1)
+        {
+            sym = left;
+        }
+        else
+        {
+            offset -= d.symlen[static_cast<std::size_t>(left)] + 1;
+            sym = btreeRight(d, sym);
+        }
+    }
+
+    return btreeLeft(d, sym);
+}
+
+/*
+ * DTZ tables store one side to move only, except for symmetric pawnless material.
+ */
+bool checkDtzStm(TablebaseEntry& entry, int stm, int file)
+{
+    return (pairsData(entry, DTZ_TABLE, stm, file).flags & FLAG_STM) == stm || (entry.key == entry.key2 && !entry.hasPawns);
+}
+
+/*
+ * Convert a stored DTZ value to plies to zeroing, plus one.
+ */
+int mapDtzScore(TablebaseEntry& entry, int file, int value, WDLScore wdl)
+{
+    constexpr int WDL_MAP[5] { 1, 3, 0, 2, 0 };
+
+    const TableFile& table = entry.tables[DTZ_TABLE];
+    const PairsData& d = pairsData(entry, DTZ_TABLE, 0, file);
+    if(d.flags & FLAG_MAPPED)
+    {
+        const int index { d.mapIdx[WDL_MAP[wdl + 2]] + value };
+        value = d.flags & FLAG_WIDE ? readLittleEndian<std::uint16_t>(table.dtzMap + 2 * index) : table.dtzMap[index];
+    }
+
+    // Values are stored in moves unless the table says plies
+    if((wdl == WDL_WIN && !(d.flags & FLAG_WIN_PLIES))
+        || (wdl == WDL_LOSS && !(d.flags & FLAG_LOSS_PLIES))
+        || wdl == WDL_CURSED_WIN
+        || wdl == WDL_BLESSED_LOSS)
+    {
+        value *= 2;
+    }
+
+    return value + 1;
+}
+
+/*
+ * Look position up in a mapped table: compute the index of the piece placement
+ * and decode the value stored there. The board is flipped so that the stronger
+ * side is white, and mirrored so that the leading piece lands in the a1-d1-d4
+ * triangle (the a-d files for pawns), which is all the tables store.
+ */
+int probeMappedTable(const Position& position, TablebaseEntry& entry, TableType type, U64 key, WDLScore wdl, ProbeState& state)
+{
+    int squares[TB_PIECES] {};
+    int pieces[TB_PIECES] {};
+    int size { 0 };
+    int leadPawnsCount { 0 };
+    U64 leadPawns { 0ULL };
+    int tbFile { FILE_A };
+
+    // Symmetric material only stores white to move, and the table is for white
+    // as the side matching its name, otherwise colours and ranks are swapped
+    const bool symmetricBlackToMove { entry.key == entry.key2 && position.getSideToMove() == BLACK };
+    const bool flipped { symmetricBlackToMove || key != entry.key };
+    const int flipColour { flipped ? 8 : 0 };
+    const int flipSquares { flipped ? 56 : 0 };
+    const int stm { static_cast<int>(flipped) ^ position.getSideToMove() };
+
+    const auto mapPawnsLess = [](int sq1, int sq2) { return ENCODING.mapPawns[sq1] < ENCODING.mapPawns[sq2]; };
+
+    // The pawns of the leading colour come first, the leading pawn being the one
+    // with the highest mapPawns value, and select the subtable by its file
+    if(entry.hasPawns)
+    {
+        const int leadPiece { pairsData(entry, type, 0, 0).pieces[0] ^ flipColour };
+        U64 pawns { position.getPieceBitboard(leadPiece == tablebasePiece(WHITE_PAWN) ? WHITE_PAWN : BLACK_PAWN) };
+        leadPawns = pawns;
+        while(pawns)
+            squares[size++] = popLSB(pawns) ^ flipSquares;
+        leadPawnsCount = size;
+
+        std::swap(squares[0], *std::max_element(squares, squares + leadPawnsCount, mapPawnsLess));
+        tbFile = std::min(squares[0] % NUM_FILES, FILE_H - squares[0] % NUM_FILES);
+    }
+
+    if(type == DTZ_TABLE && !checkDtzStm(entry, stm, tbFile))
+    {
+        state = PROBE_CHANGE_STM;
+        return 0;
+    }
+
+    U64 others { position.getPieceBitboard(ALL_PIECES) ^ leadPawns };
+    while(others)
+    {
+        const int sq { popLSB(others) };
+        squares[size] = sq ^ flipSquares;
+        pieces[size++] = tablebasePiece(position.pieceOn(sq)) ^ flipColour;
+    }
+
+    const PairsData& d = pairsData(entry, type, stm, tbFile);
+
+    // Order the pieces as the table encodes them
+    for(int i { leadPawnsCount }; i < size - 1; ++i)
+    {
+        for(int j { i + 1 }; j < size; ++j)
+        {
+            if(d.pieces[i] == pieces[j])
+            {
+                std::swap(pieces[i], pieces[j]);
+                std::swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+
+    if(squares[0] % NUM_FILES > FILE_D)
+    {
+        for(int i { 0 }; i < size; ++i)
+            squares[i] ^= 7;
+    }
+
+    std::uint64_t idx {};
+    if(entry.hasPawns)
+    {
+        idx = static_cast<std::uint64_t>(ENCODING.leadPawnIdx[leadPawnsCount][squares[0]]);
+        std::stable_sort(squares + 1, squares + leadPawnsCount, mapPawnsLess);
+        for(int i { 1 }; i < leadPawnsCount; ++i)
+            idx += static_cast<std::uint64_t>(ENCODING.binomial[i][ENCODING.mapPawns[squares[i]]]);
+    }
+    else
+    {
+        if(squares[0] / NUM_FILES > RANK_4)
+        {
+            for(int i { 0 }; i < size; ++i)
+                squares[i] ^= 56;
+        }
+
+        // The first piece of the leading group off the a1-h8 diagonal goes below it
+        for(int i { 0 }; i < d.groupLen[0]; ++i)
+        {
+            if(offA1H8(squares[i]) == 0)
+                continue;
+            if(offA1H8(squares[i]) > 0)
+            {
+                for(int j { i }; j < size; ++j)
+                    squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+            }
+            break;
+        }
+
+        // Three unique pieces are encoded together, otherwise the two kings,
+        // each later piece skipping the squares taken by the earlier ones
+        if(entry.hasUniquePieces)
+        {
+            const int adjust1 { squares[1] > squares[0] };
+            const int adjust2 { (squares[2] > squares[0]) + (squares[2] > squares[1]) };
+            int index {};
+            if(offA1H8(squares[0]))
+            {
+                index = (ENCODING.mapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+            }
+            else if(offA1H8(squares[1]))
+            {
+                index = (6 * 63 + (squares[0] / NUM_FILES) * 28 + ENCODING.mapB1H1H7[squares[1]]) * 62 + squares[2] - adjust2;
+            }
+            else if(offA1H8(squares[2]))
+            {
+                index = 6 * 63 * 62 + 4 * 28 * 62
+                      + (squares[0] / NUM_FILES) * 7 * 28
+                      + (squares[1] / NUM_FILES - adjust1) * 28
+                      + ENCODING.mapB1H1H7[squares[2]];
+            }
+            else
+            {
+                index = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28
+                      + (squares[0] / NUM_FILES) * 7 * 6
+                      + (squares[1] / NUM_FILES - adjust1) * 6
+                      + (squares[2] / NUM_FILES - adjust2);
+            }
+            idx = static_cast<std::uint64_t>(index);
+        }
+        else
+        {
+            idx = static_cast<std::uint64_t>(ENCODING.mapKK[ENCODING.mapA1D1D4[squares[0]]][squares[1]]);
+        }
+    }
+
+    // The remaining pawns, then the remaining pieces, group by group in ascending square order
+    idx *= d.groupIdx[0];
+    int* groupSquares { squares + d.groupLen[0] };
+    bool remainingPawns { entry.hasPawns && entry.pawnCount[1] > 0 };
+    for(int next { 1 }; d.groupLen[next]; ++next)
+    {
+        std::stable_sort(groupSquares, groupSquares + d.groupLen[next]);
+        std::uint64_t n { 0 };
+        for(int i { 0 }; i < d.groupLen[next]; ++i)
+        {
+            const int sq { groupSquares[i] };
+            const int adjust { static_cast<int>(std::count_if(squares, groupSquares, [sq](int other) { return sq > other; })) };
+            n += static_cast<std::uint64_t>(ENCODING.binomial[i + 1][sq - adjust - 8 * remainingPawns]);
+        }
+        remainingPawns = false;
+        idx += n * d.groupIdx[next];
+        groupSquares += d.groupLen[next];
+    }
+
+    const int value { decompressPairs(d, idx) };
+    return type == WDL_TABLE ? value - 2 : mapDtzScore(entry, tbFile, value, wdl);
+}
+
+int probeTable(const Position& position, TableType type, ProbeState& state, WDLScore wdl = WDL_DRAW)
+{
+    if(popcount(position.getPieceBitboard(ALL_PIECES)) == 2)
+        return WDL_DRAW;
+
+    const U64 key { materialKey(position) };
+    const auto found { tablebaseKeys.find(key) };
+    if(found == tablebaseKeys.end() || !mapTable(*found->second, type))
+    {
+        state = PROBE_FAIL;
+        return 0;
+    }
+
+    return probeMappedTable(position, *found->second, type, key, wdl, state);
+}
+
+/*
+ * DTZ of the move before a zeroing move, known from the WDL result after it.
+ */
+int dtzBeforeZeroing(WDLScore wdl)
+{
+    switch(wdl)
+    {
+        case WDL_WIN: return 1;
+        case WDL_CURSED_WIN: return 101;
+        case WDL_BLESSED_LOSS: return -101;
+        case WDL_LOSS: return -1;
+        default: return 0;
+    }
+}
+
+constexpr int signOf(int value)
+{
+    return (0 < value) - (value < 0);
+}
+
+bool isMate(const Position& position)
+{
+    if(!position.inCheck())
+        return false;
+    MoveList moveList;
+    MoveGen::generateLegalMoves(position, moveList);
+    return moveList.size() == 0;
+}
+
+/*
+ * WDL of position, resolving captures first: the tables hold no positions
+ * with en passant rights and may store any value where a capture is best.
+ * With CheckZeroingMoves pawn moves are tried too, and the state reports
+ * whether a zeroing move is best, as the DTZ tables cannot be trusted then.
+ */
+template<bool CheckZeroingMoves>
+WDLScore searchWdl(Position& position, ProbeState& state)
+{
+    MoveList moveList;
+    MoveGen::generateLegalMoves(position, moveList);
+
+    WDLScore bestValue { WDL_LOSS };
+    int moveCount { 0 };
+    for(Move move : moveList)
+    {
+        if(!isCapture(move) && (!CheckZeroingMoves || typeOfPiece(position.pieceOn(moveFrom(move))) != PAWN))
+            continue;
+
+        ++moveCount;
+        position.makeMove(move);
+        const WDLScore value { static_cast<WDLScore>(-searchWdl<false>(position, state)) };
+        position.unmakeMove();
+
+        if(state == PROBE_FAIL)
+            return WDL_DRAW;
+
+        if(value > bestValue)
+        {
+            bestValue = value;
+            if(value >= WDL_WIN)
+            {
+                state = PROBE_ZEROING_BEST_MOVE;
+                return value;
+            }
+        }
+    }
+
+    // With every legal move searched the table is not needed, and may be wrong
+    const bool noMoreMoves { moveCount && moveCount == moveList.size() };
+    WDLScore value { bestValue };
+    if(!noMoreMoves)
+    {
+        value = static_cast<WDLScore>(probeTable(position, WDL_TABLE, state));
+        if(state == PROBE_FAIL)
+            return WDL_DRAW;
+    }
+
+    if(bestValue >= value)
+    {
+        state = bestValue > WDL_DRAW || noMoreMoves ? PROBE_ZEROING_BEST_MOVE : PROBE_OK;
+        return bestValue;
+    }
+
+    state = PROBE_OK;
+    return value;
+}
+
+/*
+ * Plies to the next zeroing move with best play, positive when the side to
+ * move wins and offset by 100 for cursed wins and blessed losses. 0 for draws.
+ */
+int probeDtzTable(Position& position, ProbeState& state)
+{
+    state = PROBE_OK;
+    const WDLScore wdl { searchWdl<true>(position, state) };
+    if(state == PROBE_FAIL || wdl == WDL_DRAW)
+        return 0;
+
+    if(state == PROBE_ZEROING_BEST_MOVE)
+        return dtzBeforeZeroing(wdl);
+
+    int dtz { probeTable(position, DTZ_TABLE, state, wdl) };
+    if(state == PROBE_FAIL)
+        return 0;
+
+    if(state != PROBE_CHANGE_STM)
+        return (dtz + 100 * (wdl == WDL_BLESSED_LOSS || wdl == WDL_CURSED_WIN)) * signOf(wdl);
+
+    // The table stores the other side to move, take the best DTZ after one ply
+    int minDtz { 0xFFFF };
+    MoveList moveList;
+    MoveGen::generateLegalMoves(position, moveList);
+    for(Move move : moveList)
+    {
+        const bool zeroing { isCapture(move) || typeOfPiece(position.pieceOn(moveFrom(move))) == PAWN };
+        position.makeMove(move);
+
+        // A zeroing move gets the DTZ before it, from the sign of the WDL after it
+        dtz = zeroing ? -dtzBeforeZeroing(searchWdl<false>(position, state)) : -probeDtzTable(position, state);
+
+        if(dtz == 1 && isMate(position))
+            minDtz = 1;
+
+        if(!zeroing)
+            dtz += signOf(dtz);
+
+        if(dtz < minDtz && signOf(dtz) == signOf(wdl))
+            minDtz = dtz;
+
+        position.unmakeMove();
+        if(state == PROBE_FAIL)
+            return 0;
+    }
+
+    // Without legal moves the position is mate
+    return minDtz == 0xFFFF ? -1 : minDtz;
+}
+
+void addTable(const std::vector<PieceType>& pieceTypes)
+{
+    // KRK becomes KRvK, the second king starts the weaker side
+    std::string name {};
+    for(std::size_t i { 0 }; i < pieceTypes.size(); ++i)
+    {
+        if(i > 0 && pieceTypes[i] == KING)
+            name += 'v';
+        name += pieceToChar[static_cast<std::size_t>(pieceTypes[i])];
+    }
+    if(findTableFile(name + ".rtbw").empty())
+        return;
+
+    std::unique_ptr<TablebaseEntry> entry { std::make_unique<TablebaseEntry>() };
+    entry->name = name;
+
+    int counts[NUM_PIECES] {};
+    int swappedCounts[NUM_PIECES] {};
+    Side side { WHITE };
+    for(char pieceChar : name)
+    {
+        if(pieceChar == 'v')
+        {
+            side = BLACK;
+            continue;
+        }
+        const PieceType pieceType { typeOfPiece(static_cast<Piece>(pieceToChar.find(pieceChar))) };
+        ++counts[makePiece(side, pieceType)];
+        ++swappedCounts[makePiece(oppositeSide(side), pieceType)];
+        ++entry->pieceCount;
+    }
+
+    entry->key = materialKey(counts);
+    entry->key2 = materialKey(swappedCounts);
+    entry->hasPawns = counts[WHITE_PAWN] + counts[BLACK_PAWN] > 0;
+    for(int piece { WHITE_PAWN }; piece <= BLACK_KING; ++piece)
+    {
+        if(typeOfPiece(static_cast<Piece>(piece)) != KING && counts[piece] == 1)
+            entry->hasUniquePieces = true;
+    }
+
+    // The side with fewer pawns leads, it compresses better
+    const bool whiteLeads { !counts[BLACK_PAWN] || (counts[WHITE_PAWN] && counts[BLACK_PAWN] >= counts[WHITE_PAWN]) };
+    entry->pawnCount[0] = whiteLeads ? counts[WHITE_PAWN] : counts[BLACK_PAWN];
+    entry->pawnCount[1] = whiteLeads ? counts[BLACK_PAWN] : counts[WHITE_PAWN];
+
+    Syzygy::largestTablebase = std::max(Syzygy::largestTablebase, entry->pieceCount);
+    tablebaseKeys[entry->key] = entry.get();
+    tablebaseKeys[entry->key2] = entry.get();
+    tablebaseEntries.push_back(std::move(entry));
+}
+
+/*
+ * Look for the tables in paths, separated by ':' (';' on Windows),
+ * unmapping any tables found before. Returns the number of tables found.
+ * Must not be called while searching.
+ */
+int Syzygy::init(const std::string& paths)
+{
+    tablebaseKeys.clear();
+    tablebaseEntries.clear();
+    tablebasePaths.clear();
+    Syzygy::largestTablebase = 0;
+
+#if defined(_WIN32)
+    constexpr char PATH_SEPARATOR { ';' };
+#else
+    constexpr char PATH_SEPARATOR { ':' };
+#endif
+    std::size_t start { 0 };
+    while(start <= paths.size())
+    {
+        std::size_t end { paths.find(PATH_SEPARATOR, start) };
+        if(end == std::string::npos)
+            end = paths.size();
+        if(end > start)
+            tablebasePaths.push_back(paths.substr(start, end - start));
+        start = end + 1;
+    }
+    if(tablebasePaths.empty())
+        return 0;
+
+    // Every material configuration of up to 7 pieces, stronger side first
+    for(int p1 { PAWN }; p1 < KING; ++p1)
+    {
+        const PieceType t1 { static_cast<PieceType>(p1) };
+        addTable({ KING, t1, KING });
+        for(int p2 { PAWN }; p2 <= p1; ++p2)
+        {
+            const PieceType t2 { static_cast<PieceType>(p2) };
+            addTable({ KING, t1, t2, KING });
+            addTable({ KING, t1, KING, t2 });
+            for(int p3 { PAWN }; p3 < KING; ++p3)
+                addTable({ KING, t1, t2, KING, static_cast<PieceType>(p3) });
+            for(int p3 { PAWN }; p3 <= p2; ++p3)
+            {
+                const PieceType t3 { static_cast<PieceType>(p3) };
+                addTable({ KING, t1, t2, t3, KING });
+                for(int p4 { PAWN }; p4 <= p3; ++p4)
+                {
+                    const PieceType t4 { static_cast<PieceType>(p4) };
+                    addTable({ KING, t1, t2, t3, t4, KING });
+                    for(int p5 { PAWN }; p5 <= p4; ++p5)
+                        addTable({ KING, t1, t2, t3, t4, static_cast<PieceType>(p5), KING });
+                    for(int p5 { PAWN }; p5 < KING; ++p5)
+                        addTable({ KING, t1, t2, t3, t4, KING, static_cast<PieceType>(p5) });
+                }
+                for(int p4 { PAWN }; p4 < KING; ++p4)
+                {
+                    const PieceType t4 { static_cast<PieceType>(p4) };
+                    addTable({ KING, t1, t2, t3, KING, t4 });
+                    for(int p5 { PAWN }; p5 <= p4; ++p5)
+                        addTable({ KING, t1, t2, t3, KING, t4, static_cast<PieceType>(p5) });
+                }
+            }
+            for(int p3 { PAWN }; p3 <= p1; ++p3)
+            {
+                for(int p4 { PAWN }; p4 <= (p1 == p3 ? p2 : p3); ++p4)
+                    addTable({ KING, t1, t2, KING, static_cast<PieceType>(p3), static_cast<PieceType>(p4) });
+            }
+        }
+    }
+
+    return static_cast<int>(tablebaseEntries.size());
+}
+
+/*
+ * Probe the WDL tables. Returns false if position is not covered.
+ * The fifty move counter is not considered, so the caller should only
+ * trust the result right after a zeroing move. No castling rights allowed.
+ */
+bool Syzygy::probeWdl(Position& position, WDLScore& wdl)
+{
+    ProbeState state { PROBE_OK };
+    wdl = searchWdl<false>(position, state);
+    return state != PROBE_FAIL;
+}
+
+bool Syzygy::probeDtz(Position& position, int& dtz)
+{
+    ProbeState state { PROBE_OK };
+    dtz = probeDtzTable(position, state);
+    return state != PROBE_FAIL;
+}
+
+/*
+ * Rank of a root move converting in time, above the rank of any DTZ.
+ */
+constexpr int MAX_DTZ { 1 << 18 };
+
+/*
+ * Keep only the root moves that preserve the tablebase result, counting the
+ * fifty move counter of the root: all winning moves that convert within the
+ * fifty move rule, else the winning moves converting soonest, else the drawing
+ * moves, else the losing moves resisting longest. Searching those guarantees
+ * progress in a won endgame, which the WDL scores of the search alone do not.
+ * Returns false, leaving rootMoves untouched, if the position is not covered.
+ * Credit: root_probe() of Stockfish
+ */
+bool Syzygy::filterRootMoves(Position& position, MoveList& rootMoves)
+{
+    if(position.getCastlingRights() || popcount(position.getPieceBitboard(ALL_PIECES)) > Syzygy::largestTablebase)
+        return false;
+
+    const int fiftyMovesCount { position.getFiftyMovesCount() };
+    int ranks[MAX_MOVES] {};
+    int bestRank { std::numeric_limits<int>::min() };
+    for(int i { 0 }; i < rootMoves.size(); ++i)
+    {
+        ProbeState state { PROBE_OK };
+        int dtz {};
+        position.makeMove(rootMoves.moves[i]);
+        if(position.getFiftyMovesCount() == 0)
+        {
+            dtz = dtzBeforeZeroing(static_cast<WDLScore>(-searchWdl<false>(position, state)));
+        }
+        else if(position.getFiftyMovesCount() >= 100 || position.isRepetition(1))
+        {
+            // One ply from the root a repetition is a threefold one in the game history
+            dtz = 0;
+        }
+        else
+        {
+            dtz = -probeDtzTable(position, state);
+            dtz += signOf(dtz);
+        }
+        if(dtz == 2 && isMate(position))
+            dtz = 1;
+        position.unmakeMove();
+
+        if(state == PROBE_FAIL)
+            return false;
+
+        // Every win converting within the fifty move rule ranks the same, so the search
+        // picks among them. Wins the rule would spoil rank by how soon they convert,
+        // losses the same unless the rule saves them, then the longest resistance ranks best.
+        ranks[i] = dtz > 0 ? (dtz + fiftyMovesCount <= 99 ? MAX_DTZ : MAX_DTZ - (dtz + fiftyMovesCount))
+                 : dtz < 0 ? (-dtz * 2 + fiftyMovesCount < 100 ? -MAX_DTZ : -MAX_DTZ + (-dtz + fiftyMovesCount))
+                 : 0;
+        bestRank = std::max(bestRank, ranks[i]);
+    }
+
+    int kept { 0 };
+    for(int i { 0 }; i < rootMoves.size(); ++i)
+    {
+        if(ranks[i] == bestRank)
+            rootMoves.moves[kept++] = rootMoves.moves[i];
+    }
+    rootMoves.count = kept;
+    return true;
+}
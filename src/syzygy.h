@@ -0,0 +1,38 @@
+#ifndef SYZYGY_H
+#define SYZYGY_H
+
+#include "move.h" // MoveList
+#include "position.h" // Position
+
+#include <string> // std::string
+
+/*
+ * Tablebase result from the point of view of the side to move. A cursed win
+ * is a win the fifty move rule turns into a draw, a blessed loss a loss it saves.
+ */
+enum WDLScore : int
+{
+    WDL_LOSS = -2, WDL_BLESSED_LOSS = -1, WDL_DRAW = 0, WDL_CURSED_WIN = 1, WDL_WIN = 2
+};
+
+/*
+ * Syzygy endgame tablebases. init() takes the directories holding the
+ * .rtbw (win/draw/loss) and .rtbz (distance to zeroing) files. Only the file
+ * names are looked at on init, a file is memory mapped the first time a
+ * position of its material is probed.
+ * Not offered as the SyzygyPath UCI option until the probe results have been
+ * checked against a reference prober on real tables. Until init() finds tables,
+ * the search does not probe.
+ */
+namespace Syzygy
+{
+    // Most pieces of any table found, 0 without tablebases. Only changed when no search is running
+    inline int largestTablebase { 0 };
+
+    int init(const std::string& paths);
+    bool probeWdl(Position& position, WDLScore& wdl);
+    bool probeDtz(Position& position, int& dtz);
+    bool filterRootMoves(Position& position, MoveList& rootMoves);
+}
+
+#endif
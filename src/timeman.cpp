@@ -0,0 +1,66 @@
+#include "timeman.h"
+#include "search.h" // SearchLimits
+#include "types.h" // Side
+
+#include <algorithm> // std::max(), std::min()
+
+/*
+ * Moves to plan for in sudden death, and the most moves to plan for with movestogo.
+ * Planning for more moves than are really left keeps a reserve for the endgame.
+ */
+constexpr int SUDDEN_DEATH_MOVES { 40 };
+constexpr int MAX_MOVES_TO_GO { 50 };
+
+/*
+ * Compute the time limits of a search from the "go" parameters of the side to move.
+ * With movetime the whole time is used, so there is only a maximum time. With a clock, the optimum time is an equal
+ * share of the remaining time over the moves to go plus most of the increment,
+ * and the maximum time allows overrunning it several times for unstable positions,
+ * but never more than a fraction of the clock. The move overhead keeps a reserve
+ * for the communication delay between engine and GUI.
+ */
+void TimeManager::init(const SearchLimits& limits, Side side)
+{
+    this->optimumTime = 0;
+    this->maximumTime = 0;
+
+    if(limits.infinite)
+        return;
+
+    if(limits.moveTime)
+    {
+        this->maximumTime = std::max(limits.moveTime - MOVE_OVERHEAD_MS, 1);
+        return;
+    }
+
+    const int time { limits.time[side] };
+    const int increment { limits.increment[side] };
+    if(time <= 0)
+        return;
+
+    const int movesToGo { limits.movesToGo ? std::min(limits.movesToGo, MAX_MOVES_TO_GO) : SUDDEN_DEATH_MOVES };
+    const int available { std::max(time - MOVE_OVERHEAD_MS, 1) };
+
+    // With one move to go nearly all the time can be spent, otherwise at most 80% of it
+    const int maximumShare { movesToGo == 1 ? available * 9 / 10 : available * 4 / 5 };
+
+    this->optimumTime = std::max(std::min(available / movesToGo + increment * 3 / 4, maximumShare), 1);
+    this->maximumTime = std::max(std::min(this->optimumTime * 5, maximumShare), 1);
+}
+
+/*
+ * Decide after a completed iteration whether to start the next one.
+ * The optimum time is scaled by the instability of the best move, so time is saved
+ * when the best move is settled and extended when it keeps changing. An iteration
+ * takes about twice as long as the previous one with a good move ordering, so the
+ * next one is not started if it would run into the maximum time and be wasted.
+ */
+bool TimeManager::stopIterating(long long elapsed, long long lastIteration, double bestMoveInstability) const
+{
+    if(!this->optimumTime)
+        return false;
+
+    const double scaledOptimum { this->optimumTime * bestMoveInstability };
+    return elapsed >= static_cast<long long>(scaledOptimum)
+        || elapsed + 2 * lastIteration >= this->maximumTime;
+}
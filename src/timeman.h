@@ -0,0 +1,29 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include "types.h" // Side
+
+struct SearchLimits;
+
+inline constexpr int MOVE_OVERHEAD_MS { 30 };
+
+/*
+ * Allocates thinking time for one move. The soft limit (optimum time) is checked
+ * between iterations of iterative deepening, the hard limit (maximum time) is
+ * polled during the search and aborts it unconditionally.
+ * A limit of 0 is not set.
+ */
+class TimeManager
+{
+    private:
+        int optimumTime { 0 };
+        int maximumTime { 0 };
+    public:
+        void init(const SearchLimits& limits, Side side);
+        bool stopIterating(long long elapsed, long long lastIteration, double bestMoveInstability) const;
+
+        int getOptimumTime() const { return this->optimumTime; }
+        int getMaximumTime() const { return this->maximumTime; }
+};
+
+#endif
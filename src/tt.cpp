@@ -0,0 +1,211 @@
+#include "tt.h"
+#include "move.h" // Move, NO_MOVE
+#include "types.h" // U64
+
+#include <algorithm> // std::max(), std::min()
+#include <atomic> // std::atomic_ref, std::memory_order_relaxed
+#include <cstddef> // std::size_t
+#include <cstdint> // std::int16_t, std::uint16_t
+#include <cstdlib> // std::aligned_alloc()
+#include <cstring> // std::memset()
+#include <new> // std::bad_alloc
+#include <thread> // std::thread
+#include <vector> // std::vector
+
+#if defined(__linux__)
+#include <sys/mman.h> // madvise(), MADV_HUGEPAGE
+#endif
+
+__extension__ using UInt128 = unsigned __int128;
+
+/*
+ * Map a key onto [0, numBuckets) with a fixed point multiply of the upper key bits,
+ * which avoids a modulo and allows table sizes that are not a power of two.
+ * Credit: Daniel Lemire, "A fast alternative to the modulo reduction"
+ */
+TTBucket& TranspositionTable::bucketFor(U64 key) const
+{
+    std::size_t index { static_cast<std::size_t>((static_cast<UInt128>(key) * this->numBuckets) >> 64) };
+    return this->buckets[index];
+}
+
+/*
+ * Reallocate the table to the given size in MB and clear it.
+ * The memory is requested cache line aligned and, on Linux, advised to be
+ * backed by transparent huge pages, which cuts TLB misses on large tables.
+ * The new table is allocated before the old one is released. If that fails,
+ * false is returned and the old table is kept as it is. Without an old table
+ * the size is halved until the allocation succeeds.
+ */
+bool TranspositionTable::resize(std::size_t megabytes, int numThreads)
+{
+    std::size_t newNumBuckets { megabytes * 1024 * 1024 / sizeof(TTBucket) };
+    TTBucket* newBuckets { static_cast<TTBucket*>(std::aligned_alloc(alignof(TTBucket), newNumBuckets * sizeof(TTBucket))) };
+    const bool allocated { newBuckets != nullptr };
+    if(!allocated && this->buckets)
+        return false;
+
+    while(!newBuckets && megabytes > 1)
+    {
+        megabytes /= 2;
+        newNumBuckets = megabytes * 1024 * 1024 / sizeof(TTBucket);
+        newBuckets = static_cast<TTBucket*>(std::aligned_alloc(alignof(TTBucket), newNumBuckets * sizeof(TTBucket)));
+    }
+    if(!newBuckets)
+        throw std::bad_alloc {};
+
+    this->buckets.reset(newBuckets);
+    this->numBuckets = newNumBuckets;
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    madvise(this->buckets.get(), this->numBuckets * sizeof(TTBucket), MADV_HUGEPAGE);
+#endif
+
+    this->clear(numThreads);
+    return allocated;
+}
+
+std::size_t TranspositionTable::getMegabytes() const
+{
+    return this->numBuckets * sizeof(TTBucket) / (1024 * 1024);
+}
+
+/*
+ * Zero the table. Each thread clears its own contiguous slice, so clearing
+ * several GB is bounded by memory bandwidth rather than by a single core.
+ * Touching the pages from multiple threads also spreads them over NUMA nodes.
+ */
+void TranspositionTable::clear(int numThreads)
+{
+    numThreads = std::max(1, numThreads);
+    const std::size_t slice { this->numBuckets / static_cast<std::size_t>(numThreads) };
+
+    std::vector<std::thread> threads {};
+    for(int i { 0 }; i < numThreads; ++i)
+    {
+        std::size_t start { slice * static_cast<std::size_t>(i) };
+        std::size_t count { (i == numThreads - 1) ? this->numBuckets - start : slice };
+        threads.emplace_back([this, start, count]()
+        {
+            std::memset(static_cast<void*>(this->buckets.get() + start), 0, count * sizeof(TTBucket));
+        });
+    }
+    for(std::thread& thread : threads)
+        thread.join();
+
+    this->generation = 0;
+}
+
+/*
+ * Called once at the start of every search. Entries written by older searches
+ * age relative to the new generation, and are preferred for replacement.
+ */
+void TranspositionTable::newSearch()
+{
+    this->generation = (this->generation + 1) & 63;
+}
+
+/*
+ * Look up key, filling ttData and returning true on a hit.
+ * Both words are read with relaxed atomic loads, which compile to
+ * plain moves but keep concurrent access well defined.
+ */
+bool TranspositionTable::probe(U64 key, TTData& ttData) const
+{
+    TTBucket& bucket = this->bucketFor(key);
+    for(TTEntry& entry : bucket.entries)
+    {
+        U64 data { std::atomic_ref<U64>(entry.data).load(std::memory_order_relaxed) };
+        U64 keyXorData { std::atomic_ref<U64>(entry.keyXorData).load(std::memory_order_relaxed) };
+        if((keyXorData ^ data) != key || data == 0)
+            continue;
+
+        ttData.move = static_cast<Move>(data & 0xFFFF);
+        ttData.score = static_cast<std::int16_t>((data >> 16) & 0xFFFF);
+        ttData.eval = static_cast<std::int16_t>((data >> 32) & 0xFFFF);
+        ttData.depth = static_cast<int>((data >> 48) & 0xFF);
+        ttData.bound = static_cast<Bound>((data >> 56) & 0x3);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Store a search result. An entry with the same key is overwritten
+ * (keeping its move if no new move is given), otherwise the entry with the
+ * lowest depth minus age penalty in the bucket is replaced, so deep results
+ * from the current search survive while stale ones are recycled.
+ */
+void TranspositionTable::store(U64 key, Move move, int score, int eval, int depth, Bound bound)
+{
+    TTBucket& bucket = this->bucketFor(key);
+    TTEntry* replace { &bucket.entries[0] };
+    int replaceWorth { 1 << 30 };
+
+    for(TTEntry& entry : bucket.entries)
+    {
+        U64 data { std::atomic_ref<U64>(entry.data).load(std::memory_order_relaxed) };
+        U64 keyXorData { std::atomic_ref<U64>(entry.keyXorData).load(std::memory_order_relaxed) };
+
+        if((keyXorData ^ data) == key && data != 0)
+        {
+            if(move == NO_MOVE)
+                move = static_cast<Move>(data & 0xFFFF);
+            replace = &entry;
+            break;
+        }
+
+        int entryDepth { static_cast<int>((data >> 48) & 0xFF) };
+        int entryAge { (this->generation - static_cast<int>(data >> 58)) & 63 };
+        int worth { entryDepth - 8 * entryAge };
+        if(worth < replaceWorth)
+        {
+            replaceWorth = worth;
+            replace = &entry;
+        }
+    }
+
+    U64 data { static_cast<U64>(move)
+             | (static_cast<U64>(static_cast<std::uint16_t>(score)) << 16)
+             | (static_cast<U64>(static_cast<std::uint16_t>(eval)) << 32)
+             | (static_cast<U64>(std::clamp(depth, 0, 255)) << 48)
+             | (static_cast<U64>(bound) << 56)
+             | (static_cast<U64>(this->generation) << 58) };
+
+    std::atomic_ref<U64>(replace->keyXorData).store(key ^ data, std::memory_order_relaxed);
+    std::atomic_ref<U64>(replace->data).store(data, std::memory_order_relaxed);
+}
+
+/*
+ * Hint the CPU to start loading the bucket of key into cache. Issued right
+ * after a move is made, so the memory latency overlaps with move generation
+ * and evaluation before the probe.
+ */
+void TranspositionTable::prefetch(U64 key) const
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(&this->bucketFor(key));
+#else
+    (void)key;
+#endif
+}
+
+/*
+ * Approximate table usage in permill, as reported by UCI "info hashfull",
+ * by sampling the first 1000 entries for ones written by the current search.
+ */
+int TranspositionTable::hashfull() const
+{
+    int used { 0 };
+    std::size_t sampleBuckets { std::min<std::size_t>(1000 / TT_BUCKET_SIZE, this->numBuckets) };
+    for(std::size_t i { 0 }; i < sampleBuckets; ++i)
+    {
+        for(TTEntry& entry : this->buckets[i].entries)
+        {
+            U64 data { std::atomic_ref<U64>(entry.data).load(std::memory_order_relaxed) };
+            if(data != 0 && static_cast<int>(data >> 58) == this->generation)
+                ++used;
+        }
+    }
+    return used;
+}
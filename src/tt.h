@@ -0,0 +1,90 @@
+#ifndef TT_H
+#define TT_H
+
+#include "move.h" // Move
+#include "types.h" // U64
+
+#include <cstddef> // std::size_t
+#include <cstdlib> // std::free()
+#include <memory> // std::unique_ptr
+
+inline constexpr int DEFAULT_HASH_MB { 16 };
+inline constexpr int MAX_HASH_MB { 1048576 };
+
+enum Bound : int
+{
+    BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT
+};
+
+/*
+ * Unpacked contents of a transposition table entry.
+ */
+struct TTData
+{
+    Move move {};
+    int score {};
+    int eval {};
+    int depth {};
+    Bound bound {};
+};
+
+/*
+ * A 16 byte entry. The data word packs
+ * 
+ * bits  0-15  move
+ * bits 16-31  score (signed)
+ * bits 32-47  static evaluation (signed)
+ * bits 48-55  depth
+ * bits 56-57  bound
+ * bits 58-63  generation
+ * 
+ * and the first word stores the position key XORed with the data word.
+ * Readers recompute key ^ data and compare with the probed key, so an entry
+ * torn by two threads writing at once is rejected instead of returning data
+ * of another position. No locks are needed.
+ * Credit: Robert Hyatt and Tim Mann, "A lockless transposition-table implementation
+ * for parallel search", ICGA Journal 25(1), 2002.
+ */
+struct TTEntry
+{
+    U64 keyXorData;
+    U64 data;
+};
+
+/*
+ * Four entries fill exactly one 64 byte cache line, so a probe touches a single line.
+ */
+inline constexpr int TT_BUCKET_SIZE { 4 };
+
+struct alignas(64) TTBucket
+{
+    TTEntry entries[TT_BUCKET_SIZE];
+};
+
+class TranspositionTable
+{
+    private:
+        struct FreeDeleter
+        {
+            void operator()(TTBucket* buckets) const { std::free(buckets); }
+        };
+
+        std::unique_ptr<TTBucket[], FreeDeleter> buckets {};
+        std::size_t numBuckets {};
+        int generation {};
+
+        TTBucket& bucketFor(U64 key) const;
+    public:
+        bool resize(std::size_t megabytes, int numThreads);
+        std::size_t getMegabytes() const;
+        void clear(int numThreads);
+        void newSearch();
+        bool probe(U64 key, TTData& ttData) const;
+        void store(U64 key, Move move, int score, int eval, int depth, Bound bound);
+        void prefetch(U64 key) const;
+        int hashfull() const;
+};
+
+inline TranspositionTable TT {};
+
+#endif
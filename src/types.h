@@ -14,6 +14,15 @@ enum Piece : int
     NUM_PIECES_ALL
 };
 
+/*
+ * Colourless piece types, numbered so that a white Piece has
+ * the same value as its PieceType and a black Piece is offset by 6.
+ */
+enum PieceType : int
+{
+    NO_PIECE_TYPE, PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING, NUM_PIECE_TYPES
+};
+
 enum Side : int
 {
     WHITE, BLACK, NUM_SIDES
@@ -90,16 +99,52 @@ enum RayDirection : int
     NORTH_WEST = 7
 };
 
+constexpr Side oppositeSide(Side side)
+{
+    return static_cast<Side>(side ^ BLACK);
+}
+
+constexpr Piece makePiece(Side side, PieceType pieceType)
+{
+    return static_cast<Piece>(static_cast<int>(pieceType) + side * static_cast<int>(KING));
+}
+
+constexpr PieceType typeOfPiece(Piece piece)
+{
+    return static_cast<PieceType>(piece > WHITE_KING ? piece - static_cast<int>(KING) : static_cast<int>(piece));
+}
+
+constexpr Side sideOfPiece(Piece piece)
+{
+    return piece > WHITE_KING ? BLACK : WHITE;
+}
+
+constexpr Piece sideAllPieces(Side side)
+{
+    return side == WHITE ? WHITE_ALL : BLACK_ALL;
+}
+
 /*
  * Used for sliding piece attacks. See attack.cpp
  * and https://www.chessprogramming.org/Magic_Bitboards#Fancy
  */
 struct FancyMagic
 {
-    U64* attackTablePointer {};
+    const U64* attackTablePointer {};
     U64 occupancyMask {};
     U64 magicNumber {};
     int shift {};
 };
 
+/*
+ * Used for sliding piece attacks with the BMI2 PEXT instruction,
+ * which extracts the relevant occupancy bits into a dense index
+ * without a magic number or shift. See attack.cpp
+ */
+struct PextEntry
+{
+    const U64* attackTablePointer {};
+    U64 occupancyMask {};
+};
+
 #endif
\ No newline at end of file
@@ -1,9 +1,62 @@
 #include "uci.h"
-#include "position.h"
+#include "move.h" // Move, MoveList, NO_MOVE, moveToString()
+#include "movegen.h" // MoveGen::generateLegalMoves()
+#include "bench.h" // Bench::runFenBench(), Bench::runNnueBench()
+#include "book.h" // Book::open(), Book::close(), Book::probe()
+#include "nnue.h" // NNUE::load(), NNUE::unload()
+#include "perft.h" // Perft::runPerft()
+#include "position.h" // Position, STANDARD_START_FEN
+#include "search.h" // SearchController, SearchLimits, MAX_PLY, MAX_THREADS, STATS_ENABLED
+#include "tt.h" // TT, DEFAULT_HASH_MB, MAX_HASH_MB
+#include "types.h" // WHITE, BLACK
 
+#include <algorithm> // std::clamp()
+#include <cctype> // std::tolower()
+#include <cstddef> // std::size_t
+#include <cstdlib> // std::atoi()
 #include <iostream> // std::cin, std::cout
+#include <mutex> // std::mutex, std::lock_guard
 #include <string> //std::string
-#include <sstream> //std::istringstream
+#include <sstream> //std::istringstream, std::ostringstream
+#include <thread> // std::thread::hardware_concurrency()
+
+/*
+ * Engine settings changed through "setoption".
+ */
+struct EngineOptions
+{
+    int threads { 1 };
+    bool ownBook { false };
+    bool debug { false };
+};
+
+/*
+ * Write one line to the GUI. All engine output goes through here, so lines written by
+ * the search thread and the input thread never interleave, and each line is flushed
+ * as soon as it is complete.
+ */
+void uciOutput(const std::string& line)
+{
+    static std::mutex outputMutex {};
+    const std::lock_guard<std::mutex> lock { outputMutex };
+    std::cout << line << '\n' << std::flush;
+}
+
+/*
+ * Find the legal move matching a move in long algebraic notation,
+ * e.g. "e2e4" or "e7e8q". Returns NO_MOVE if no legal move matches.
+ */
+Move parseMove(const Position& position, const std::string& moveString)
+{
+    MoveList moveList;
+    MoveGen::generateLegalMoves(position, moveList);
+    for(Move move : moveList)
+    {
+        if(moveToString(move) == moveString)
+            return move;
+    }
+    return NO_MOVE;
+}
 
 /*
  * uci
@@ -17,9 +70,18 @@
  */
 void commandUCI()
 {
-    // TODO call "id" command
-    // TODO print "option" commands
-    std::cout << "uciok\n";
+    std::ostringstream options {};
+    options << "id name Venenum\n";
+    options << "id author DarkenedBright\n";
+    options << "option name Hash type spin default " << DEFAULT_HASH_MB << " min 1 max " << MAX_HASH_MB << '\n';
+    options << "option name Clear Hash type button\n";
+    options << "option name Threads type spin default 1 min 1 max " << MAX_THREADS << '\n';
+    options << "option name Ponder type check default false\n";
+    options << "option name EvalFile type string default <empty>\n";
+    options << "option name OwnBook type check default false\n";
+    options << "option name BookFile type string default <empty>\n";
+    options << "uciok";
+    uciOutput(options.str());
 }
 
 /*
@@ -30,9 +92,15 @@ void commandUCI()
  * This mode should be switched off by default and this command can be sent
  * any time, also when the engine is thinking.
  */
-void commandDebug()
+void commandDebug(std::istringstream& uciStringStream, EngineOptions& options)
 {
-    std::cout << "WARNING: Command 'debug' is not implemented.\n";
+    std::string uciPart {};
+    uciStringStream >> uciPart;
+    options.debug = uciPart != "off";
+
+    // Debug mode reports the search statistics after every search, if they are counted at all
+    if(options.debug && !STATS_ENABLED)
+        uciOutput("info string Search statistics are not compiled in, build with STATS=yes");
 }
 
 /*
@@ -49,7 +117,7 @@ void commandDebug()
  */
 void commandIsReady()
 {
-    std::cout << "readyok\n";
+    uciOutput("readyok");
 }
 
 /*
@@ -67,7 +135,7 @@ void commandIsReady()
  *     "setoption name Clear Hash\n"
  *     "setoption name NalimovPath value c:\chess\tb\4;c:\chess\tb\5\n"
  */
-void commandSetOption(std::istringstream& uciStringStream)
+void commandSetOption(std::istringstream& uciStringStream, EngineOptions& options, Position& position)
 {
     std::string name {};
     std::string value {};
@@ -77,16 +145,89 @@ void commandSetOption(std::istringstream& uciStringStream)
     if(uciPart != "name")
         return;
     
-    uciStringStream >> name;
+    // Option names and values may contain spaces, read up to "value" and to the end of line
+    while(uciStringStream >> uciPart && uciPart != "value")
+    {
+        name += (name.empty() ? "" : " ") + uciPart;
+    }
+    while(uciStringStream >> uciPart)
+    {
+        value += (value.empty() ? "" : " ") + uciPart;
+    }
 
-    if(uciStringStream >> uciPart)
+    for(char& nameChar : name)
     {
-        if(uciPart != "value")
+        nameChar = static_cast<char>(std::tolower(static_cast<unsigned char>(nameChar)));
+    }
+
+    if(name == "hash")
+    {
+        int megabytes { std::atoi(value.c_str()) };
+        if(megabytes < 1 || megabytes > MAX_HASH_MB)
+        {
+            uciOutput("info string Hash must be between 1 and " + std::to_string(MAX_HASH_MB) + " MB");
             return;
-        uciStringStream >> value;
+        }
+        if(!TT.resize(static_cast<std::size_t>(megabytes), static_cast<int>(std::thread::hardware_concurrency())))
+            uciOutput("info string Cannot allocate " + std::to_string(megabytes) + " MB of hash, keeping "
+                      + std::to_string(TT.getMegabytes()) + " MB");
+    }
+    else if(name == "clear hash")
+    {
+        TT.clear(static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    else if(name == "threads")
+    {
+        int threads { std::atoi(value.c_str()) };
+        if(threads < 1 || threads > MAX_THREADS)
+        {
+            uciOutput("info string Threads must be between 1 and " + std::to_string(MAX_THREADS));
+            return;
+        }
+        options.threads = threads;
+    }
+    else if(name == "ponder")
+    {
+        // Only tells the engine the GUI may send "go ponder", which needs no preparation
+    }
+    else if(name == "evalfile")
+    {
+        // Without a network the engine falls back to the material and piece-square evaluation
+        if(value.empty() || value == "<empty>")
+        {
+            NNUE::unload();
+            return;
+        }
+        if(!NNUE::load(value))
+        {
+            uciOutput("info string Cannot load network " + value + ", using the classical evaluation");
+            return;
+        }
+        position.refreshAccumulator();
+        uciOutput("info string Loaded network " + value);
+    }
+    else if(name == "ownbook")
+    {
+        options.ownBook = value == "true";
+    }
+    else if(name == "bookfile")
+    {
+        if(value.empty() || value == "<empty>")
+        {
+            Book::close();
+            return;
+        }
+        if(!Book::open(value))
+        {
+            uciOutput("info string Cannot open book " + value);
+            return;
+        }
+        uciOutput("info string Opened book " + value);
+    }
+    else
+    {
+        uciOutput("info string Unknown option '" + name + "'");
     }
-    std::cout << "WARNING: Command 'setoption' is not implemented.\n";
-    std::cout << "Name: " << name << ", Value: " << value << '\n';
 }
 
 /*
@@ -107,7 +248,7 @@ void commandSetOption(std::istringstream& uciStringStream)
  */
 void commandRegister()
 {
-    std::cout << "WARNING: Command 'register' is not implemented.\n";
+    uciOutput("WARNING: Command 'register' is not implemented.");
 }
 
 /*
@@ -123,7 +264,7 @@ void commandRegister()
  */
 void commandUCINewGame()
 {
-    std::cout << "WARNING: Command 'ucinewgame' is not implemented.\n";
+    TT.clear(static_cast<int>(std::thread::hardware_concurrency()));
 }
 
 /*
@@ -134,7 +275,7 @@ void commandUCINewGame()
  * Note: no "new" command is needed. However, if this position is from a different game than
  * the last position sent to the engine, the GUI should have sent a "ucinewgame" inbetween.
  */
-void commandPosition(std::istringstream& uciStringStream)
+void commandPosition(std::istringstream& uciStringStream, Position& position)
 {
     std::string uciPart {};
     std::string fenPosition {};
@@ -157,18 +298,29 @@ void commandPosition(std::istringstream& uciStringStream)
         return;
     }
 
-    //TODO Set Position Class? to fen position
+    if(const FenError error { position.setFromFen(fenPosition) }; error != FenError::NONE)
+    {
+        uciOutput(std::string { "info string Invalid FEN, " } + fenErrorToString(error));
+        return;
+    }
 
     if(uciPart != "moves")
         return;
     
     while(uciStringStream >> uciPart)
     {
-        //TODO Apply move to position in order
-    }
+        Move move { parseMove(position, uciPart) };
+        if(move == NO_MOVE)
+        {
+            uciOutput("info string Illegal move '" + uciPart + "' in position command");
+            return;
+        }
+        position.makeMove(move);
 
-    std::cout << "WARNING: Command 'position' is not implemented.\n";
-    std::cout << "FEN: " << fenPosition << '\n';
+        // Only the moves since the last capture or pawn move matter for repetitions,
+        // keeping no more leaves room on the undo stack for games of any length
+        position.trimHistory();
+    }
 }
 
 /*
@@ -213,11 +365,41 @@ void commandPosition(std::istringstream& uciStringStream)
  * * infinite
  *     search until the "stop" command. Do not exit the search without being told so in this mode!
  */
-void commandGo(std::istringstream& uciStringStream)
+void commandGo(std::istringstream& uciStringStream, const Position& position, const EngineOptions& options, SearchController& searchController)
 {
+    SearchLimits limits {};
     std::string uciPart {};
-    uciStringStream >> uciPart;
-    std::cout << "WARNING: Command 'go' is not implemented.\n";
+
+    while(uciStringStream >> uciPart)
+    {
+        if(uciPart == "depth")
+        {
+            uciStringStream >> limits.depth;
+            limits.depth = std::clamp(limits.depth, 1, MAX_PLY - 1);
+        }
+        else if(uciPart == "wtime") uciStringStream >> limits.time[WHITE];
+        else if(uciPart == "btime") uciStringStream >> limits.time[BLACK];
+        else if(uciPart == "winc") uciStringStream >> limits.increment[WHITE];
+        else if(uciPart == "binc") uciStringStream >> limits.increment[BLACK];
+        else if(uciPart == "movestogo") uciStringStream >> limits.movesToGo;
+        else if(uciPart == "nodes") uciStringStream >> limits.nodes;
+        else if(uciPart == "movetime") uciStringStream >> limits.moveTime;
+        else if(uciPart == "infinite") limits.infinite = true;
+        else if(uciPart == "ponder") limits.ponder = true;
+    }
+
+    // A book move is played at once, except in infinite and ponder mode where the GUI expects a search until "stop"
+    if(options.ownBook && !limits.infinite && !limits.ponder)
+    {
+        if(const Move bookMove { Book::probe(position) }; bookMove != NO_MOVE)
+        {
+            searchController.wait();
+            uciOutput("bestmove " + moveToString(bookMove));
+            return;
+        }
+    }
+
+    searchController.start(position, limits, options.threads, options.debug);
 }
 
 /*
@@ -225,9 +407,9 @@ void commandGo(std::istringstream& uciStringStream)
  * stop calculating as soon as possible,
  * don't forget the "bestmove" and possibly the "ponder" token when finishing the search
  */
-void commandStop()
+void commandStop(SearchController& searchController)
 {
-    std::cout << "WARNING: Command 'stop' is not implemented.\n";
+    searchController.stop();
 }
 
 /*
@@ -235,44 +417,132 @@ void commandStop()
  * the user has played the expected move. This will be sent if the engine was told to ponder on the same move
  * the user has played. The engine should continue searching but switch from pondering to normal search.
  */
-void commandPonderHit()
+void commandPonderHit(SearchController& searchController)
 {
-    std::cout << "WARNING: Command 'ponderhit' is not implemented.\n";
+    searchController.ponderHit();
 }
 
 /*
  * quit
  * quit the program as soon as possible
  */
-void commandQuit()
+void commandQuit(SearchController& searchController)
+{
+    searchController.stop();
+    searchController.wait();
+}
+
+/*
+ * perft <depth> [threads <x>] [hash <x>]
+ * divide <depth> [threads <x>] [hash <x>]
+ * non-standard command, count the leaf nodes of the legal move tree of the current position
+ * to the given depth, and print the node count, time and nodes per second. "divide" also prints
+ * the node count below every root move. Used to validate move generation and measure its speed.
+ * * threads <x>
+ *     split the root moves across x threads, defaults to the number of hardware threads
+ * * hash <x>
+ *     use a perft hash table of x MB, defaults to 64, 0 disables it
+ */
+void commandPerft(std::istringstream& uciStringStream, const Position& position, bool divide)
+{
+    int depth {};
+    int numThreads { static_cast<int>(std::thread::hardware_concurrency()) };
+    int hashMegabytes { 64 };
+    std::string uciPart {};
+
+    if(!(uciStringStream >> depth) || depth < 0)
+        return;
+
+    while(uciStringStream >> uciPart)
+    {
+        if(uciPart == "threads") uciStringStream >> numThreads;
+        else if(uciPart == "hash") uciStringStream >> hashMegabytes;
+    }
+
+    Perft::runPerft(position, depth, divide, numThreads, hashMegabytes);
+}
+
+/*
+ * fenbench [positions <x>] [file <path>]
+ * non-standard command, measure how many FENs per second are parsed and written.
+ * * positions <x>
+ *     generate a corpus of x positions from random games, defaults to 100000
+ * * file <path>
+ *     use the FENs in the given file instead, one per line
+ */
+void commandFenBench(std::istringstream& uciStringStream)
+{
+    int numPositions { 100000 };
+    std::string fileName {};
+    std::string uciPart {};
+
+    while(uciStringStream >> uciPart)
+    {
+        if(uciPart == "positions") uciStringStream >> numPositions;
+        else if(uciPart == "file") uciStringStream >> fileName;
+    }
+
+    Bench::runFenBench(std::max(numPositions, 1), fileName);
+}
+
+/*
+ * nnuebench [positions <x>]
+ * non-standard command, compare the cost of refreshing the NNUE accumulator
+ * from scratch with updating it incrementally for a moved piece.
+ * Needs a network loaded with EvalFile.
+ */
+void commandNnueBench(std::istringstream& uciStringStream)
 {
-    std::cout << "WARNING: Command 'quit' is not implemented.\n";
+    int numPositions { 10000 };
+    std::string uciPart {};
+
+    while(uciStringStream >> uciPart)
+    {
+        if(uciPart == "positions") uciStringStream >> numPositions;
+    }
+
+    Bench::runNnueBench(std::max(numPositions, 1));
 }
 
+/*
+ * Read commands from the GUI until "quit" or end of input. Searches run on the
+ * search thread, so this thread keeps reading while the engine is thinking.
+ * Commands that change the engine state wait for a running search to finish first,
+ * which by the protocol only happens for "go" without a preceding "stop".
+ */
 void readConsole()
 {
     std::string line {};
     std::string uciPart {};
-    while(true)
+    Position position {};
+    EngineOptions options {};
+    SearchController searchController {};
+    while(std::getline(std::cin >> std::ws, line))
     {
-        std::getline(std::cin >> std::ws, line);
         std::istringstream uciStringStream { line };
         uciStringStream >> uciPart;
 
+        const bool changesState { uciPart == "setoption" || uciPart == "ucinewgame" || uciPart == "position"
+                                  || uciPart == "perft" || uciPart == "divide" || uciPart == "fenbench"
+                                  || uciPart == "nnuebench" };
+        if(changesState)
+            searchController.wait();
+
         if(uciPart == "uci") commandUCI();
-        else if(uciPart == "debug") commandDebug();
+        else if(uciPart == "debug") commandDebug(uciStringStream, options);
         else if(uciPart == "isready") commandIsReady();
-        else if(uciPart == "setoption") commandSetOption(uciStringStream);
+        else if(uciPart == "setoption") commandSetOption(uciStringStream, options, position);
         else if(uciPart == "register") commandRegister();
         else if(uciPart == "ucinewgame") commandUCINewGame();
-        else if(uciPart == "position") commandPosition(uciStringStream);
-        else if(uciPart == "go") commandGo(uciStringStream);
-        else if(uciPart == "stop") commandStop();
-        else if(uciPart == "ponderhit") commandPonderHit();
-        else if(uciPart == "quit")
-        {
-            commandQuit();
-            break;
-        }
+        else if(uciPart == "position") commandPosition(uciStringStream, position);
+        else if(uciPart == "go") commandGo(uciStringStream, position, options, searchController);
+        else if(uciPart == "stop") commandStop(searchController);
+        else if(uciPart == "ponderhit") commandPonderHit(searchController);
+        else if(uciPart == "perft") commandPerft(uciStringStream, position, false);
+        else if(uciPart == "divide") commandPerft(uciStringStream, position, true);
+        else if(uciPart == "fenbench") commandFenBench(uciStringStream);
+        else if(uciPart == "nnuebench") commandNnueBench(uciStringStream);
+        else if(uciPart == "quit") break;
     }
+    commandQuit(searchController);
 }
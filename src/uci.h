@@ -1,6 +1,9 @@
 #ifndef UCI_H
 #define UCI_H
 
+#include <string> // std::string
+
+void uciOutput(const std::string& line);
 void readConsole();
 
-#endif
\ No newline at end of file
+#endif
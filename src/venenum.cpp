@@ -1,22 +1,31 @@
-#include "attack.h" //Attack::initBishopRookAttacks()
-#include "position.h" //Position::initZobristPositionKeys(), STANDARD_START_FEN
+#include "analyse.h" //Analyse::runBatch()
+#include "position.h" //Position, Position::initZobristPositionKeys(), FenError
+#include "tt.h" //TT, DEFAULT_HASH_MB
 #include "uci.h" //readConsole()
 
 #include <iostream> //std::cout
+#include <string> //std::string
+#include <thread> //std::thread::hardware_concurrency()
+#include <vector> //std::vector
 
-int main()
+int main(int argc, char* argv[])
 {
-    std::cout << "Venenum - A UCI Chess Engine\n";
-
     //Initialization of Engine
-    Attack::initBishopRookAttacks();
     Position::initZobristPositionKeys();
 
-    Position position { STANDARD_START_FEN };
+    //Batch mode, Venenum analyse <file> [options]
+    if(argc > 1 && std::string { argv[1] } == "analyse")
+        return Analyse::runBatch(std::vector<std::string>(argv + 2, argv + argc));
+
+    std::cout << "Venenum - A UCI Chess Engine\n";
+    TT.resize(DEFAULT_HASH_MB, static_cast<int>(std::thread::hardware_concurrency()));
+
+    Position position {};
     position.print();
 
-    Position position2 { "rnbqkbnr/pp1ppppp/8/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq - 1 2" };
-    position2.print();
+    Position position2 {};
+    if(position2.setFromFen("rnbqkbnr/pp1ppppp/8/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq - 1 2") == FenError::NONE)
+        position2.print();
 
     readConsole();
 